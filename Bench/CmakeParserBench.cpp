@@ -0,0 +1,225 @@
+// Orchestration benchmark over synthetic projects: lexing, Parse (cold and
+// from the model cache), model evaluation alone, rsp generation, command
+// generation, the compile_commands.json export and an end-to-end Build
+// against CmakeParser_fake_gcc, so regressions show up without a real
+// toolchain.
+// Usage: CmakeParser_bench [sources] [iterations] [build_sources] [include_depth] [flags]
+
+#include "CmakeParser.hpp"
+#include "ThreadPoolService.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace cmakeparser;
+
+struct ProjectShape {
+    size_t sources;
+    size_t includeDepth;
+    size_t flags;
+};
+
+static bool WriteText(const std::filesystem::path& path, const std::string& text)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        std::fprintf(stderr, "cannot create %s\n", path.string().c_str());
+        return false;
+    }
+    ofs << text;
+    return true;
+}
+
+// root/CMakeLists.txt pulls in a chain of includeDepth .cmake files, each
+// adding an include dir and its share of the flags, then lists the sources.
+static bool GenerateProject(const std::filesystem::path& root, const ProjectShape& shape)
+{
+    std::string base = root.generic_string();
+    for (size_t level = 0; level < shape.includeDepth; ++level) {
+        std::string text = "# generated level " + std::to_string(level) + "\n";
+        text += "include_directories(${BASE_DIR}/inc/level_" + std::to_string(level) + ")\n";
+        text += "set(BENCH_FLAGS \"${BENCH_FLAGS}";
+        for (size_t f = level; f < shape.flags; f += shape.includeDepth)
+            text += " -DFEATURE_" + std::to_string(f) + "=1";
+        text += "\")\n";
+        if (level + 1 < shape.includeDepth)
+            text += "include(${CMAKE_CURRENT_LIST_DIR}/level_" + std::to_string(level + 1) + ".cmake)\n";
+        if (!WriteText(root / "cmake" / ("level_" + std::to_string(level) + ".cmake"), text))
+            return false;
+    }
+
+    std::string text;
+    text.reserve(shape.sources * 64 + 1024);
+    text += "cmake_minimum_required(VERSION 3.20)\n";
+    text += "set(BASE_DIR " + base + ")\n";
+    text += "project(Bench C ASM)\n";
+    if (shape.includeDepth > 0)
+        text += "include(cmake/level_0.cmake)\n";
+    text += "set(CMAKE_C_FLAGS \"-mcpu=cortex-m3 -mthumb -O2 -ffunction-sections -fdata-sections ${BENCH_FLAGS}\")\n";
+    text += "set(CMAKE_EXE_LINKER_FLAGS \"-Wl,--gc-sections -Wl,-Map=${BASE_DIR}/NinjaBuilder/M3_CITY2/Build/MAIN.map\")\n";
+    text += "set(SRC\n";
+    for (size_t i = 0; i < shape.sources; ++i)
+        text += "    ${BASE_DIR}/src/module_" + std::to_string(i / 64) + "/file_" + std::to_string(i) + ".c\n";
+    text += ")\n";
+    text += "add_executable(MAIN ${SRC})\n";
+    text += "target_link_libraries(MAIN m)\n";
+    return WriteText(root / "CMakeLists.txt", text);
+}
+
+// Puts the fake toolchain where CmakeParser looks for arm-none-eabi-gcc.
+static bool InstallFakeToolchain(const std::filesystem::path& root, const std::filesystem::path& fakeGcc)
+{
+    auto bin = root / "NinjaBuilder" / "tools" / "gcc-arm-none-eabi" / "bin";
+    std::error_code ec;
+    std::filesystem::create_directories(bin, ec);
+    for (auto name : { L"arm-none-eabi-gcc", L"arm-none-eabi-objcopy" }) {
+        auto to = bin / (std::wstring(name) + platform::kExeSuffix);
+        std::filesystem::copy_file(fakeGcc, to, std::filesystem::copy_options::overwrite_existing, ec);
+        if (ec) {
+            std::fprintf(stderr, "cannot install %s: %s\n", fakeGcc.string().c_str(), ec.message().c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class F>
+static double TimeMs(int iterations, F&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+// As above, with prepare run before each iteration outside the timing.
+template<class P, class F>
+static double TimeMs(int iterations, P&& prepare, F&& fn)
+{
+    std::chrono::steady_clock::duration total{};
+    for (int i = 0; i < iterations; ++i) {
+        prepare();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        total += std::chrono::steady_clock::now() - start;
+    }
+    return std::chrono::duration<double, std::milli>(total).count() / iterations;
+}
+
+static void Report(const char* name, double ms, size_t items, const char* unit)
+{
+    std::printf("%-18s %10.3f ms  %12.0f %s/s\n", name, ms, ms > 0 ? items * 1000.0 / ms : 0.0, unit);
+}
+
+int main(int argc, char* argv[])
+{
+    ProjectShape shape;
+    shape.sources = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+    size_t buildSources = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 500;
+    shape.includeDepth = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 32;
+    shape.flags = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 2000;
+    if (iterations < 1)
+        iterations = 1;
+
+    auto fakeGcc = std::filesystem::absolute(argv[0]).parent_path() / (std::wstring(L"CmakeParser_fake_gcc") + platform::kExeSuffix);
+    auto work = std::filesystem::temp_directory_path() / "cmakeparser_bench";
+    auto parseRoot = work / "parse";
+    auto buildRoot = work / "build";
+    std::error_code ec;
+    std::filesystem::remove_all(work, ec);
+    if (!GenerateProject(parseRoot, shape))
+        return 1;
+    ProjectShape buildShape = shape;
+    buildShape.sources = buildSources;
+    if (!GenerateProject(buildRoot, buildShape) || !InstallFakeToolchain(buildRoot, fakeGcc))
+        return 1;
+
+    ThreadPoolService::Instance();
+    auto quiet = [](const wchar_t*, const wchar_t*, bool, bool) {};
+    auto listFile = (parseRoot / "CMakeLists.txt").wstring();
+    auto modelCache = std::filesystem::path(ModelCache(listFile).Path());
+
+    std::printf("sources: %zu, include depth: %zu, flags: %zu, iterations: %d\n", shape.sources, shape.includeDepth, shape.flags, iterations);
+
+    ListFileTree tree;
+    double lexMs = TimeMs(iterations, [&] { tree.Load(listFile, {}); });
+    Report("lex", lexMs, tree.Size(), "files");
+
+    CmakeParser parser(false, quiet);
+    double parseMs = TimeMs(iterations, [&] {
+        std::filesystem::remove(modelCache, ec);
+        if (!parser.Parse(listFile))
+            std::fprintf(stderr, "parse failed\n");
+    });
+    size_t sources = parser.GetModel().SrcCount();
+    Report("parse (cold)", parseMs, sources, "sources");
+
+    // Evaluate alone, over the tree the last cold parse lexed.
+    double modelMs = TimeMs(iterations, [&] {
+        if (!parser.EvaluateLexed())
+            std::fprintf(stderr, "model failed\n");
+    });
+    Report("model", modelMs, sources, "sources");
+
+    double cachedMs = TimeMs(iterations, [&] { parser.Parse(listFile); });
+    Report("parse (cached)", cachedMs, sources, "sources");
+
+    // Unchanged rsp files are not rewritten, so each iteration starts from an
+    // empty rsp directory to time the write path too.
+    double rspMs = TimeMs(iterations, [&] {
+        std::filesystem::remove_all(parser.GetRspPath(), ec);
+        std::filesystem::create_directories(parser.GetRspPath(), ec);
+    }, [&] {
+        RspFileGenerator rsp(parser.GetModel(), parser.GetRspPath());
+        std::wstring rspFile;
+        for (size_t i = 0; i < sources; ++i)
+            rsp.CreateNextRspFile(rspFile);
+        rsp.Flush();
+        rsp.CreateLinkRspFile({});
+    });
+    Report("rsp", rspMs, sources, "sources");
+
+    std::wstring rspFile = parser.GetRspPath() + L"/compile.rsp";
+    double commandMs = TimeMs(iterations, [&] {
+        CommandGenerator generator(parser.GetModel(), L"/bin/", L"/arm/", parser.GetObjPath());
+        CompileJob job;
+        while (generator.HasNext())
+            generator.Next(job, rspFile);
+    });
+    Report("commands", commandMs, sources, "sources");
+
+    auto exportFile = (work / "compile_commands.json").wstring();
+    double exportMs = TimeMs(iterations, [&] {
+        RspFileGenerator rsp(parser.GetModel(), parser.GetRspPath());
+        CommandGenerator generator(parser.GetModel(), L"/bin/", L"/arm/", parser.GetObjPath());
+        BuildPlanExporter exporter(generator, rsp, parser.GetBuildPath());
+        if (!exporter.Collect() || !exporter.WriteCompileCommands(exportFile, false))
+            std::fprintf(stderr, "export failed\n");
+    });
+    Report("export", exportMs, sources, "sources");
+
+    if (buildSources > 0) {
+        auto buildList = (buildRoot / "CMakeLists.txt").wstring();
+        int code = 0;
+        double buildMs = TimeMs(iterations, [&] {
+            CmakeParser full(true, quiet);
+            full.Parse(buildList);
+            code = full.Build(false, platform::kInvalidFileHandle);
+        });
+        if (code != 0) {
+            std::printf("build failed with code %d (is %s built?)\n", code, fakeGcc.string().c_str());
+            return 1;
+        }
+        Report("build (e2e)", buildMs, buildSources, "objects");
+    }
+
+    std::filesystem::remove_all(work, ec);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+// Stand-in for arm-none-eabi-gcc and arm-none-eabi-objcopy used by
+// CmakeParser_bench. It understands just enough of the command lines that
+// CommandGenerator produces to write a dummy object and depfile (compile),
+// the -o output (link) or the last argument (objcopy). Set
+// CMAKEPARSER_FAKE_GCC_MS to make every invocation sleep that long.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static bool WriteFile(const std::string& path, const std::string& content)
+{
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        std::fprintf(stderr, "fake gcc: cannot create %s\n", path.c_str());
+        return false;
+    }
+    std::fwrite(content.data(), 1, content.size(), f);
+    std::fclose(f);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (const char* ms = std::getenv("CMAKEPARSER_FAKE_GCC_MS"))
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::atoi(ms)));
+
+    std::string out, dep, target, src;
+    bool objcopy = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            out = argv[++i];
+        else if (std::strcmp(argv[i], "-MF") == 0 && i + 1 < argc)
+            dep = argv[++i];
+        else if (std::strcmp(argv[i], "-MT") == 0 && i + 1 < argc)
+            target = argv[++i];
+        else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            src = argv[++i];
+        else if (std::strncmp(argv[i], "-O", 2) == 0)
+            objcopy = true;
+    }
+
+    if (objcopy && argc > 1)
+        return WriteFile(argv[argc - 1], "fake image\n") ? 0 : 1;
+    if (out.empty()) {
+        std::fprintf(stderr, "fake gcc: no output given\n");
+        return 1;
+    }
+    if (!WriteFile(out, "fake object\n"))
+        return 1;
+    if (!dep.empty() && !WriteFile(dep, (target.empty() ? out : target) + ": " + src + "\n"))
+        return 1;
+    return 0;
+}
\ No newline at end of file
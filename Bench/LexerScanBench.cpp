@@ -0,0 +1,73 @@
+// Micro-benchmark: SIMD vs scalar scanning in CmakeLexer over a synthetic
+// multi-megabyte CMakeLists.txt. Usage: CmakeParser_scan_bench [sources] [iterations]
+
+#include "CmakeLexer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace cmakeparser;
+
+static std::string GenerateText(size_t sources)
+{
+    std::string text;
+    text.reserve(sources * 96);
+    text += "cmake_minimum_required(VERSION 3.20)\n";
+    text += "# generated project\n";
+    text += "set(BASE_DIR C:/work/firmware)\n";
+    text += "set(CMAKE_C_FLAGS \"-mcpu=cortex-m3 -mthumb -O2 -ffunction-sections -fdata-sections -Wall -Wextra -std=gnu11\")\n";
+    text += "include_directories(\n";
+    for (size_t i = 0; i < sources / 16 + 1; ++i)
+        text += "    ${BASE_DIR}/src/module_" + std::to_string(i) + "/include\n";
+    text += ")\n\n";
+    text += "set(SRC\n";
+    for (size_t i = 0; i < sources; ++i) {
+        if (i % 64 == 0)
+            text += "    # group " + std::to_string(i / 64) + " (generated)\n";
+        text += "    ${BASE_DIR}/src/module_" + std::to_string(i / 16) + "/file_" + std::to_string(i) + ".c\n";
+    }
+    text += ")\n";
+    text += "add_executable(MAIN ${SRC})\n";
+    return text;
+}
+
+template<class Scanner>
+static double Run(const std::string& text, int iterations, size_t& commands, size_t& args)
+{
+    AST ast;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        ast.Reset();
+        BasicCmakeLexer<Scanner> lexer(text);
+        lexer.Lex(ast);
+        commands = ast.Commands().size();
+        args = ast.ArgCount();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t sources = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+    auto text = GenerateText(sources);
+    double mb = text.size() / (1024.0 * 1024.0);
+
+    size_t scalarCommands = 0, scalarArgs = 0, simdCommands = 0, simdArgs = 0;
+    Run<ScalarScanner>(text, 1, scalarCommands, scalarArgs);
+    double scalar = Run<ScalarScanner>(text, iterations, scalarCommands, scalarArgs);
+    double simd = Run<SimdScanner>(text, iterations, simdCommands, simdArgs);
+
+    std::printf("input: %.2f MB, %zu commands, %zu args\n", mb, scalarCommands, scalarArgs);
+    std::printf("scalar: %8.3f ms  %8.1f MB/s\n", scalar * 1000.0, mb / scalar);
+    std::printf("simd:   %8.3f ms  %8.1f MB/s  (x%.2f)\n", simd * 1000.0, mb / simd, scalar / simd);
+
+    if (scalarCommands != simdCommands || scalarArgs != simdArgs) {
+        std::printf("mismatch: simd produced %zu commands, %zu args\n", simdCommands, simdArgs);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
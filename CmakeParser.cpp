@@ -1,6 +1,4 @@
 ﻿#include "CmakeParser.hpp"
-#include <io.h>
-#include <fcntl.h>
 #include <iostream>
 #include <string>
 #include <ThreadPool.h>
@@ -9,11 +7,13 @@ using namespace cmakeparser;
 
 int wmain(int argc, wchar_t* argv[])
 {
-	ThreadPoolService::Instance();
-    int oldOutMode = _setmode(_fileno(stdout), _O_U16TEXT);
+    platform::ConsoleMode console;
 
     std::wstring cmakePath;
     bool isFullLog = false;
+    bool isIncremental = false;
+    bool isWatch = false;
+    BuildOptions options;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -22,6 +22,58 @@ int wmain(int argc, wchar_t* argv[])
         {
             isFullLog = true;
         }
+        else if (arg == L"-incremental")
+        {
+            isIncremental = true;
+        }
+        else if (arg == L"--watch")
+        {
+            isWatch = true;
+        }
+        else if (arg == L"-j" && i + 1 < argc)
+        {
+            options.jobs = wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (arg.size() > 2 && arg.compare(0, 2, L"-j") == 0)
+        {
+            options.jobs = wcstoul(arg.c_str() + 2, nullptr, 10);
+        }
+        else if (arg == L"-l" && i + 1 < argc)
+        {
+            options.maxLoad = wcstod(argv[++i], nullptr);
+        }
+        else if (arg == L"-m" && i + 1 < argc)
+        {
+            options.maxRssMb = wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == L"--cache-dir" && i + 1 < argc)
+        {
+            options.cacheDir = argv[++i];
+        }
+        else if (arg == L"--cache-size" && i + 1 < argc)
+        {
+            options.cacheMaxMb = wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == L"--trace" && i + 1 < argc)
+        {
+            options.tracePath = argv[++i];
+        }
+        else if (arg == L"--group-output")
+        {
+            options.groupOutput = true;
+        }
+        else if (arg == L"--compile-commands" && i + 1 < argc)
+        {
+            options.compileCommandsPath = argv[++i];
+        }
+        else if (arg == L"--ninja" && i + 1 < argc)
+        {
+            options.ninjaPath = argv[++i];
+        }
+        else if (arg == L"--inline-rsp")
+        {
+            options.inlineRsp = true;
+        }
         else if (cmakePath.empty())
         {
             cmakePath = arg;
@@ -42,17 +94,48 @@ int wmain(int argc, wchar_t* argv[])
     if (cmakePath.empty())
     {
         std::wcerr << L"Ошибка: пустой путь!\n";
-        _setmode(_fileno(stdout), oldOutMode);
+        console.Restore();
         return -1;
     }
 
-    CmakeParser parser(true);
+    ThreadPoolService::Instance(options.jobs + 1);
+
+    // Exporting the plan leaves the build directory as it is.
+    bool isExport = !options.compileCommandsPath.empty() || !options.ninjaPath.empty();
+    CmakeParser parser(!isIncremental && !isExport);
+    parser.SetOptions(options);
+    platform::FileHandle handle = platform::kInvalidFileHandle;
+    if (isExport)
+    {
+        int code = parser.Parse(cmakePath) ? parser.Export() : -1;
+        console.Restore();
+        platform::ExitProcessNow(code);
+    }
+    if (isWatch)
+    {
+        parser.Watch(cmakePath, isFullLog, handle);
+    }
+
     parser.Parse(cmakePath);
-    HANDLE handle;
     auto result = parser.Build(isFullLog, handle);
     std::wcout << L"Очищаем консоль.....\n";
     std::wcout.flush();
-    _setmode(_fileno(stdout), oldOutMode);
-    TerminateProcess(GetCurrentProcess(), (UINT)result);
-    return result;
-}
\ No newline at end of file
+    console.Restore();
+    platform::ExitProcessNow(result);
+}
+
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+    std::vector<std::wstring> args;
+    for (int i = 0; i < argc; ++i)
+        args.push_back(platform::Utf8ToWide(argv[i]));
+
+    std::vector<wchar_t*> wargv;
+    for (auto& a : args)
+        wargv.push_back(a.data());
+    wargv.push_back(nullptr);
+
+    return wmain(argc, wargv.data());
+}
+#endif
\ No newline at end of file
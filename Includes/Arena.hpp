@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace cmakeparser {
+
+	// Monotonic bump allocator. Blocks double in size, so n bytes cost O(log n)
+	// heap allocations; deallocation is a no-op and Rewind() makes every block
+	// reusable without returning it to the heap.
+	class Arena : public std::pmr::memory_resource
+	{
+	public:
+		explicit Arena(size_t firstBlock = 64 * 1024) : firstBlock_(firstBlock) {}
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+			while (current_ < blocks_.size()) {
+				auto& b = blocks_[current_];
+				size_t start = (used_ + align - 1) & ~(align - 1);
+				if (start + size <= b.size) {
+					used_ = start + size;
+					return b.data.get() + start;
+				}
+				current_++;
+				used_ = 0;
+			}
+
+			size_t last = blocks_.empty() ? firstBlock_ / 2 : blocks_.back().size;
+			size_t blockSize = std::max(last * 2, size + align);
+			blocks_.push_back({ std::make_unique<std::byte[]>(blockSize), blockSize });
+			current_ = blocks_.size() - 1;
+			used_ = 0;
+			return Allocate(size, align);
+		}
+
+		// Everything allocated so far becomes invalid; the blocks are kept.
+		void Rewind() {
+			current_ = 0;
+			used_ = 0;
+		}
+
+		size_t BlockCount() const { return blocks_.size(); }
+
+	private:
+		struct Block {
+			std::unique_ptr<std::byte[]> data;
+			size_t size;
+		};
+
+		std::vector<Block> blocks_;
+		size_t current_ = 0;
+		size_t used_ = 0;
+		size_t firstBlock_;
+
+		void* do_allocate(size_t size, size_t align) override { return Allocate(size, align); }
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
+}
\ No newline at end of file
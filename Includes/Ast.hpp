@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "Arena.hpp"
+
+namespace cmakeparser {
+
+	// Unquoted args are list elements and are split again after variable
+	// expansion; quoted args are single values; bracket args are literal.
+	enum class ArgKind : uint8_t { Unquoted, Quoted, Bracket };
+
+	// Names and args are UTF-8 views into the mapped CMake file, or into
+	// AST::Store() for args that are not one contiguous run of source text.
+	// Args live in one flat buffer owned by the AST; see AST::Args().
+	struct Command {
+		std::string_view name;
+		std::string_view raw_args;
+		uint32_t first_arg = 0;
+		uint32_t arg_count = 0;
+		int line_start = -1;
+		int line_end = -1;
+
+	public:
+		// CMake command names are case-insensitive.
+		bool NameIs(std::string_view lower) const {
+			if (name.size() != lower.size())
+				return false;
+			for (size_t i = 0; i < name.size(); ++i) {
+				char c = name[i];
+				if (c >= 'A' && c <= 'Z')
+					c = (char)(c - 'A' + 'a');
+				if (c != lower[i])
+					return false;
+			}
+			return true;
+		}
+	};
+
+	// Commands, the flat arg buffer and decoded arg text all live in one
+	// monotonic arena; Reset() rewinds it, so re-parsing reuses the same blocks.
+	class AST {
+	public:
+		AST() = default;
+		AST(const AST&) = delete;
+		AST& operator=(const AST&) = delete;
+		// The arena is heap-owned, so containers keep pointing at it after a move.
+		AST(AST&&) = default;
+		AST& operator=(AST&&) = delete;
+
+		void AddCommand(Command&& cmd) { commands_.push_back(std::move(cmd)); }
+		std::span<const Command> Commands() const { return commands_; }
+
+		std::span<const std::string_view> Args(const Command& c) const {
+			return std::span<const std::string_view>(args_).subspan(c.first_arg, c.arg_count);
+		}
+
+		std::span<const ArgKind> Kinds(const Command& c) const {
+			return std::span<const ArgKind>(kinds_).subspan(c.first_arg, c.arg_count);
+		}
+
+		void AddArg(std::string_view arg, ArgKind kind = ArgKind::Unquoted) {
+			args_.push_back(arg);
+			kinds_.push_back(kind);
+		}
+		uint32_t ArgCount() const { return (uint32_t)args_.size(); }
+
+		std::string_view Store(std::string_view s) {
+			if (s.empty())
+				return {};
+			char* p = static_cast<char*>(arena_->Allocate(s.size(), 1));
+			std::memcpy(p, s.data(), s.size());
+			return std::string_view(p, s.size());
+		}
+
+		void Reset() {
+			commands_ = std::pmr::vector<Command>(arena_.get());
+			args_ = std::pmr::vector<std::string_view>(arena_.get());
+			kinds_ = std::pmr::vector<ArgKind>(arena_.get());
+			arena_->Rewind();
+		}
+
+	private:
+		std::unique_ptr<Arena> arena_ = std::make_unique<Arena>();
+		std::pmr::vector<Command> commands_{ arena_.get() };
+		std::pmr::vector<std::string_view> args_{ arena_.get() };
+		std::pmr::vector<ArgKind> kinds_{ arena_.get() };
+	};
+}
\ No newline at end of file
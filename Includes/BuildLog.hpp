@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "Hash.hpp"
+#include "Platform.hpp"
+
+namespace cmakeparser {
+
+	struct BuildLogEntry {
+		uint64_t objHash = 0;
+		uint64_t commandHash = 0;
+		uint64_t rspHash = 0;
+		uint64_t toolHash = 0;
+		int64_t mtime = 0;
+		uint32_t durationMs = 0;
+		uint32_t peakRssMb = 0;
+	};
+
+	// On-disk layout is the open-addressing table itself, so loading is one read
+	// and lookup by object path is a probe into table_.
+	class BuildLog
+	{
+	public:
+		static constexpr uint32_t kMagic = 0x4C425043; // "CPBL"
+		static constexpr uint32_t kVersion = 3;
+
+		bool Load(const std::wstring& path) {
+			std::lock_guard<std::mutex> lk(mutex_);
+			table_.assign(kInitialCapacity, {});
+			count_ = 0;
+			dirty_ = false;
+
+			std::error_code ec;
+			auto size = std::filesystem::file_size(path, ec);
+			if (ec || size < sizeof(Header))
+				return false;
+
+			std::vector<char> data(size);
+			std::ifstream ifs(std::filesystem::path(path), std::ios::binary);
+			if (!ifs || !ifs.read(data.data(), size))
+				return false;
+
+			Header header;
+			std::memcpy(&header, data.data(), sizeof(header));
+			if (header.magic != kMagic || header.version != kVersion)
+				return false;
+			if (header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0)
+				return false;
+			if (size != sizeof(Header) + (uint64_t)header.capacity * sizeof(BuildLogEntry))
+				return false;
+
+			table_.resize(header.capacity);
+			std::memcpy(table_.data(), data.data() + sizeof(Header), header.capacity * sizeof(BuildLogEntry));
+			for (auto& e : table_) {
+				if (e.objHash != 0)
+					count_++;
+			}
+			if (count_ != header.count || count_ >= table_.size()) {
+				table_.assign(kInitialCapacity, {});
+				count_ = 0;
+				return false;
+			}
+			return true;
+		}
+
+		bool Save(const std::wstring& path) {
+			std::lock_guard<std::mutex> lk(mutex_);
+			if (!dirty_)
+				return true;
+
+			Header header{ kMagic, kVersion, (uint32_t)table_.size(), (uint32_t)count_ };
+			std::string data(sizeof(header) + table_.size() * sizeof(BuildLogEntry), '\0');
+			std::memcpy(data.data(), &header, sizeof(header));
+			std::memcpy(data.data() + sizeof(header), table_.data(), table_.size() * sizeof(BuildLogEntry));
+			if (!platform::ReplaceFile(path, data.data(), data.size())) {
+				std::wcerr << L"Cannot create file: " << path << L"\n";
+				return false;
+			}
+			dirty_ = false;
+			return true;
+		}
+
+		bool Find(const std::wstring& objPath, BuildLogEntry& out) const {
+			std::lock_guard<std::mutex> lk(mutex_);
+			auto key = KeyOf(objPath);
+			size_t mask = table_.size() - 1;
+			for (size_t i = key & mask;; i = (i + 1) & mask) {
+				if (table_[i].objHash == 0)
+					return false;
+				if (table_[i].objHash == key) {
+					out = table_[i];
+					return true;
+				}
+			}
+		}
+
+		void Record(const std::wstring& objPath, uint64_t commandHash, uint64_t rspHash, uint64_t toolHash, int64_t mtime, uint32_t durationMs, uint32_t peakRssMb) {
+			std::lock_guard<std::mutex> lk(mutex_);
+			if ((count_ + 1) * 4 >= table_.size() * 3)
+				Grow();
+
+			BuildLogEntry e{ KeyOf(objPath), commandHash, rspHash, toolHash, mtime, durationMs, peakRssMb };
+			Insert(e);
+			dirty_ = true;
+		}
+
+		static int64_t FileTime(const std::wstring& path) {
+			std::error_code ec;
+			auto t = std::filesystem::last_write_time(path, ec);
+			if (ec)
+				return 0;
+			return (int64_t)t.time_since_epoch().count();
+		}
+
+		// The current time in FileTime() units.
+		static int64_t FileTimeNow() {
+			return (int64_t)std::filesystem::file_time_type::clock::now().time_since_epoch().count();
+		}
+
+		// Path, size and mtime of the compiler binary stand in for its identity.
+		static uint64_t ToolHash(const std::wstring& toolPath) {
+			std::error_code ec;
+			uint64_t h = HashString(toolPath);
+			auto size = std::filesystem::file_size(toolPath, ec);
+			h = HashCombine(h, ec ? 0 : (uint64_t)size);
+			return HashCombine(h, (uint64_t)FileTime(toolPath));
+		}
+
+	private:
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t capacity;
+			uint32_t count;
+		};
+
+		static constexpr size_t kInitialCapacity = 64;
+
+		std::vector<BuildLogEntry> table_ = std::vector<BuildLogEntry>(kInitialCapacity);
+		size_t count_ = 0;
+		bool dirty_ = false;
+		mutable std::mutex mutex_;
+
+		static uint64_t KeyOf(const std::wstring& objPath) {
+			auto h = HashString(std::filesystem::path(objPath).lexically_normal().wstring());
+			return h == 0 ? 1 : h;
+		}
+
+		void Insert(const BuildLogEntry& e) {
+			size_t mask = table_.size() - 1;
+			for (size_t i = e.objHash & mask;; i = (i + 1) & mask) {
+				if (table_[i].objHash == 0) {
+					table_[i] = e;
+					count_++;
+					return;
+				}
+				if (table_[i].objHash == e.objHash) {
+					table_[i] = e;
+					return;
+				}
+			}
+		}
+
+		void Grow() {
+			std::vector<BuildLogEntry> old(table_.size() * 2);
+			old.swap(table_);
+			count_ = 0;
+			for (auto& e : old) {
+				if (e.objHash != 0)
+					Insert(e);
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace cmakeparser {
+
+	struct BuildOptions {
+		size_t jobs = 0;          // -j N, 0 = hardware_concurrency
+		double maxLoad = 0.0;     // -l <load>, 0 = no limit
+		size_t maxRssMb = 0;      // -m <MB>, 0 = no budget
+		std::wstring cacheDir;    // --cache-dir <dir>, empty = no object cache
+		size_t cacheMaxMb = 5120; // --cache-size <MB>
+		std::wstring tracePath;   // --trace <file>, empty = no trace
+		bool groupOutput = false; // --group-output, each compile's lines as one block
+		std::wstring compileCommandsPath; // --compile-commands <file>
+		std::wstring ninjaPath;           // --ninja <file>
+		bool inlineRsp = false;           // --inline-rsp, flags instead of @rsp in compile_commands.json
+	};
+}
\ No newline at end of file
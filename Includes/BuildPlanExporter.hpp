@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CommandGenerator.hpp"
+#include "Platform.hpp"
+#include "RspFileGenerator.hpp"
+#include "Task.h"
+#include "Trace.hpp"
+
+namespace cmakeparser {
+
+	// Writes the build plan for other tools without running it:
+	// compile_commands.json for clangd and friends, and a build.ninja that runs
+	// exactly the commands Build would. Entries are serialized by pool tasks in
+	// chunks and streamed to disk in order as each chunk is ready; the file is
+	// written under a temporary name and renamed, so readers never see half of it.
+	//
+	// Build runs the compiler in the working directory, but ninja runs it in
+	// the directory it is started from and clangd may not honor "directory",
+	// so relative sources, objects, include dirs and rsp files are written
+	// against baseDir, the working directory the model was parsed in.
+	class BuildPlanExporter
+	{
+	public:
+		static constexpr size_t kMinChunkItems = 256;
+		static constexpr size_t kMaxChunks = 64;
+
+		BuildPlanExporter(CommandGenerator& generator, RspFileGenerator& rspGenerator, const std::wstring& baseDir)
+			: generator_(generator), rspGenerator_(rspGenerator), baseDir_(baseDir) {
+			rspGenerator_.SetBaseDir(baseDir_);
+		}
+
+		// Generates every compile job and writes the rsp files they name.
+		bool Collect() {
+			while (generator_.HasNext()) {
+				CompileJob job;
+				std::wstring rspFile;
+				if (!rspGenerator_.CreateNextRspFile(rspFile))
+					return false;
+				if (generator_.Next(job, rspFile)) {
+					job.source = Absolute(job.source);
+					job.obj = Absolute(job.obj);
+					job.depFile = Absolute(job.depFile);
+					job.rsp = Absolute(job.rsp);
+					job.command = generator_.CommandFor(job);
+					jobs_.push_back(std::move(job));
+				}
+				else if (!generator_.Error().empty())
+					return false;
+			}
+			if (!rspGenerator_.Flush())
+				return false;
+			linkRsp_ = rspGenerator_.CreateLinkRspFile(generator_.GetLinks());
+			if (linkRsp_.empty())
+				return false;
+			linkRsp_ = Absolute(linkRsp_);
+			return true;
+		}
+
+		size_t Size() const { return jobs_.size(); }
+
+		// "directory" is the base dir. With inlineRsp the flags replace the @rsp
+		// argument, for tools that do not expand response files.
+		bool WriteCompileCommands(const std::wstring& path, bool inlineRsp) {
+			std::string dir;
+			TraceArgs::AppendEscaped(dir, platform::WideToUtf8(baseDir_));
+			std::wstring flags;
+			if (inlineRsp) {
+				flags = rspGenerator_.CompileFlags();
+				std::replace(flags.begin(), flags.end(), L'\n', L' ');
+				while (!flags.empty() && flags.back() == L' ')
+					flags.pop_back();
+			}
+
+			return WriteChunked(path, "[\n", jobs_.size(), [&](size_t i, std::string& out) {
+				auto& job = jobs_[i];
+				if (i > 0)
+					out += ",\n";
+				out += "  {\"directory\": \"";
+				out += dir;
+				out += "\", \"file\": \"";
+				TraceArgs::AppendEscaped(out, platform::WideToUtf8(job.source));
+				out += "\", \"output\": \"";
+				TraceArgs::AppendEscaped(out, platform::WideToUtf8(job.obj));
+				out += "\", \"command\": \"";
+				TraceArgs::AppendEscaped(out, platform::WideToUtf8(inlineRsp ? generator_.InlineRsp(job, flags) : job.command));
+				out += "\"}";
+			}, "\n]\n");
+		}
+
+		// One edge per object with the same command Build runs, then the link
+		// and the bin/hex images.
+		bool WriteNinja(const std::wstring& path, const std::wstring& elfPath, const std::wstring& binPath, const std::wstring& hexPath) {
+			auto elf = Absolute(elfPath);
+			auto bin = Absolute(binPath);
+			auto hex = Absolute(hexPath);
+			std::string head = "# Generated by CmakeParser, do not edit.\n"
+				"ninja_required_version = 1.3\n\n"
+				"rule cc\n  command = $cmd\n  depfile = $out.d\n  deps = gcc\n  description = CC $in\n\n"
+				"rule link\n  command = $cmd\n  description = LINK $out\n\n"
+				"rule objcopy\n  command = $cmd\n  description = OBJCOPY $out\n\n";
+
+			std::string tail = "\nbuild " + Path(elf) + ": link";
+			for (auto& job : jobs_)
+				tail += " $\n    " + Path(job.obj);
+			tail += " | " + Path(linkRsp_) + "\n  cmd = " + Value(generator_.CreateLinkCommand(linkRsp_, elf)) + "\n";
+			tail += "build " + Path(bin) + ": objcopy " + Path(elf) + "\n  cmd = " + Value(generator_.CreateBinCommand(elf, bin)) + "\n";
+			tail += "build " + Path(hex) + ": objcopy " + Path(elf) + "\n  cmd = " + Value(generator_.CreateHexCommand(elf, hex)) + "\n";
+			tail += "\ndefault " + Path(bin) + " " + Path(hex) + "\n";
+
+			return WriteChunked(path, head, jobs_.size(), [&](size_t i, std::string& out) {
+				auto& job = jobs_[i];
+				out += "build " + Path(job.obj) + ": cc " + Path(job.source) + " | " + Path(job.rsp) + "\n";
+				out += "  cmd = " + Value(job.command) + "\n";
+			}, tail);
+		}
+
+	private:
+		CommandGenerator& generator_;
+		RspFileGenerator& rspGenerator_;
+		std::wstring baseDir_;
+		std::vector<CompileJob> jobs_;
+		std::wstring linkRsp_;
+
+		std::wstring Absolute(const std::wstring& path) const {
+			return RspFileGenerator::Absolute(baseDir_, path);
+		}
+
+		// A path in a build line: spaces, colons and dollars are escaped.
+		static std::string Path(const std::wstring& path) {
+			std::string out;
+			for (char c : platform::WideToNative(path)) {
+				if (c == '$' || c == ' ' || c == ':')
+					out += '$';
+				out += c;
+			}
+			return out;
+		}
+
+		// A variable value: only dollars are special.
+		static std::string Value(const std::wstring& value) {
+			std::string out;
+			for (char c : platform::WideToNative(value)) {
+				if (c == '$')
+					out += '$';
+				out += c;
+			}
+			return out;
+		}
+
+		// Serializes count items in chunks on the pool; the calling thread writes
+		// head, each chunk as soon as it and all before it are done, then tail.
+		// Streams to the same temporary name platform::ReplaceFile() uses.
+		template<class F>
+		static bool WriteChunked(const std::wstring& path, const std::string& head, size_t count, F&& item, const std::string& tail) {
+			auto tmp = platform::TempPathFor(path);
+			std::ofstream ofs(std::filesystem::path(tmp), std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!ofs) {
+				std::wcerr << L"Cannot create file: " << tmp << L"\n";
+				return false;
+			}
+			ofs.write(head.data(), head.size());
+
+			size_t chunks = std::min(kMaxChunks, (count + kMinChunkItems - 1) / kMinChunkItems);
+			size_t per = chunks > 0 ? (count + chunks - 1) / chunks : 0;
+			std::vector<std::string> parts(chunks);
+			std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[chunks]);
+			std::vector<Task<void>> tasks;
+			tasks.reserve(chunks);
+			for (size_t c = 0; c < chunks; ++c) {
+				ready[c].store(false, std::memory_order_relaxed);
+				Task<void> task([&item, &parts, &ready, c, from = c * per, to = std::min(count, (c + 1) * per)] {
+					for (size_t i = from; i < to; ++i)
+						item(i, parts[c]);
+					ready[c].store(true, std::memory_order_release);
+					ready[c].notify_one();
+				});
+				task.Start();
+				tasks.push_back(std::move(task));
+			}
+
+			for (size_t c = 0; c < chunks; ++c) {
+				ready[c].wait(false, std::memory_order_acquire);
+				ofs.write(parts[c].data(), parts[c].size());
+				std::string().swap(parts[c]);
+			}
+			WaitAll(tasks);
+			ofs.write(tail.data(), tail.size());
+			ofs.close();
+			if (!ofs || !platform::ReplaceWith(tmp, path)) {
+				std::wcerr << L"Cannot create file: " << path << L"\n";
+				return false;
+			}
+			return true;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace cmakeparser {
+
+	// Little helpers for the machine-local binary caches: values are written
+	// raw, strings and vectors with a 32-bit length prefix.
+	class ByteWriter
+	{
+	public:
+		template<class T>
+		void Put(const T& v) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			buf_.append(reinterpret_cast<const char*>(&v), sizeof(T));
+		}
+
+		template<class CharT>
+		void PutString(std::basic_string_view<CharT> s) {
+			Put((uint32_t)s.size());
+			buf_.append(reinterpret_cast<const char*>(s.data()), s.size() * sizeof(CharT));
+		}
+
+		template<class T>
+		void PutVector(const std::vector<T>& v) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			Put((uint32_t)v.size());
+			buf_.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+		}
+
+		const std::string& Data() const { return buf_; }
+
+	private:
+		std::string buf_;
+	};
+
+	// Reads what ByteWriter wrote; every getter fails instead of reading past
+	// the end, so a truncated or foreign file is rejected.
+	class ByteReader
+	{
+	public:
+		explicit ByteReader(std::string_view data) : data_(data) {}
+
+		template<class T>
+		bool Get(T& v) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			if (data_.size() - pos_ < sizeof(T))
+				return false;
+			std::memcpy(&v, data_.data() + pos_, sizeof(T));
+			pos_ += sizeof(T);
+			return true;
+		}
+
+		template<class CharT>
+		bool GetString(std::basic_string<CharT>& s) {
+			uint32_t n = 0;
+			if (!Get(n) || (data_.size() - pos_) / sizeof(CharT) < n)
+				return false;
+			s.resize(n);
+			if (n != 0)
+				std::memcpy(s.data(), data_.data() + pos_, n * sizeof(CharT));
+			pos_ += n * sizeof(CharT);
+			return true;
+		}
+
+		template<class T>
+		bool GetVector(std::vector<T>& v) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			uint32_t n = 0;
+			if (!Get(n) || (data_.size() - pos_) / sizeof(T) < n)
+				return false;
+			v.resize(n);
+			if (n != 0)
+				std::memcpy(v.data(), data_.data() + pos_, n * sizeof(T));
+			pos_ += n * sizeof(T);
+			return true;
+		}
+
+		bool AtEnd() const { return pos_ == data_.size(); }
+
+	private:
+		std::string_view data_;
+		size_t pos_ = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "Ast.hpp"
+#include "SimdScan.hpp"
+
+namespace cmakeparser {
+
+	// Single pass over the UTF-8 bytes of a CMake file, following the CMake
+	// language grammar: quoted, unquoted and bracket ([[..]], [=[..]=]) args,
+	// line and bracket comments, escape sequences and ';' lists in unquoted
+	// args. Variable references are left for the model to resolve.
+	//
+	// Args go to the AST's flat buffer. They stay views into text unless escapes
+	// had to be decoded; those are built in one reused scratch string and copied
+	// into the AST storage once. Scanner picks the SIMD or the scalar loops.
+	//
+	// As in CMake, "\" before a letter or digit other than t, n and r is an
+	// error: Error() and ErrorLine() report the first one.
+	template<class Scanner = SimdScanner>
+	class BasicCmakeLexer
+	{
+	public:
+		explicit BasicCmakeLexer(std::string_view text) : text_(text), n_(text.size()) {
+			if (n_ >= 3 && (unsigned char)text_[0] == 0xEF && (unsigned char)text_[1] == 0xBB && (unsigned char)text_[2] == 0xBF)
+				pos_ = 3;
+		}
+
+		void Lex(AST& ast) {
+			while (pos_ < n_) {
+				SkipSpaces();
+				if (pos_ >= n_) break;
+
+				if (text_[pos_] == '#') {
+					SkipComment();
+					continue;
+				}
+
+				if (!IsIdentStart(text_[pos_])) {
+					pos_++;
+					continue;
+				}
+
+				int ls = line_;
+				auto name = ReadIdent();
+				SkipSpaces();
+
+				if (pos_ < n_ && text_[pos_] == '(') {
+					pos_++;
+					Command c;
+					c.name = name;
+					c.first_arg = ast.ArgCount();
+					c.line_start = ls;
+					ReadArguments(c, ast);
+					c.arg_count = ast.ArgCount() - c.first_arg;
+					c.line_end = line_;
+					ast.AddCommand(std::move(c));
+				}
+			}
+		}
+
+		const std::string& Error() const { return error_; }
+		int ErrorLine() const { return errorLine_; }
+
+	private:
+		std::string_view text_;
+		size_t pos_ = 0;
+		size_t n_ = 0;
+		int line_ = 1;
+		std::string scratch_;
+		std::string error_;
+		int errorLine_ = 0;
+
+		static bool IsAlpha(char c) {
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+		}
+
+		static bool IsIdentStart(char c) {
+			return IsAlpha(c) || c == '_';
+		}
+
+		static bool IsIdent(char c) {
+			return IsAlpha(c) || (c >= '0' && c <= '9') || c == '_' || c == '-';
+		}
+
+		void SkipSpaces() {
+			pos_ = Scanner::SkipSpaces(text_.data(), pos_, n_, line_);
+		}
+
+		std::string_view ReadIdent() {
+			size_t start = pos_;
+			while (pos_ < n_ && IsIdent(text_[pos_])) pos_++;
+			return text_.substr(start, pos_ - start);
+		}
+
+		// Reads up to and including the ')' closing the command. Nested parens
+		// are passed on as "(" and ")" args, like CMake does.
+		void ReadArguments(Command& c, AST& ast) {
+			size_t open = pos_;
+			int depth = 1;
+			for (;;) {
+				SkipSpaces();
+				if (pos_ >= n_) {
+					c.raw_args = text_.substr(open);
+					return;
+				}
+				switch (text_[pos_]) {
+				case '(':
+					depth++;
+					ast.AddArg(text_.substr(pos_++, 1));
+					break;
+				case ')':
+					if (--depth == 0) {
+						c.raw_args = text_.substr(open, pos_ - open);
+						pos_++;
+						return;
+					}
+					ast.AddArg(text_.substr(pos_++, 1));
+					break;
+				case '#':
+					SkipComment();
+					break;
+				case '"':
+					ReadQuoted(ast);
+					break;
+				case '[':
+					if (!ReadBracket(ast))
+						ReadUnquoted(ast);
+					break;
+				default:
+					ReadUnquoted(ast);
+					break;
+				}
+			}
+		}
+
+		// Number of '=' in a bracket opener "[==[" at i, or -1 if there is none.
+		int BracketLevel(size_t i) const {
+			if (i >= n_ || text_[i] != '[') return -1;
+			size_t j = i + 1;
+			while (j < n_ && text_[j] == '=') j++;
+			return j < n_ && text_[j] == '[' ? (int)(j - i - 1) : -1;
+		}
+
+		// Scans from pos_ to the bracket closer of the given level; returns the
+		// index of its first ']' (or n_) and leaves pos_ past the closer.
+		size_t FindBracketClose(int level) {
+			size_t i = pos_;
+			while ((i = Scanner::template FindAny<']', '\n'>(text_.data(), i, n_)) < n_) {
+				if (text_[i] == '\n') {
+					line_++;
+					i++;
+					continue;
+				}
+				size_t j = i + 1;
+				while (j < n_ && text_[j] == '=' && (int)(j - i - 1) < level) j++;
+				if ((int)(j - i - 1) == level && j < n_ && text_[j] == ']') {
+					pos_ = j + 1;
+					return i;
+				}
+				i++;
+			}
+			pos_ = n_;
+			return n_;
+		}
+
+		// Bracket argument: taken verbatim, minus a newline right after the opener.
+		bool ReadBracket(AST& ast) {
+			int level = BracketLevel(pos_);
+			if (level < 0) return false;
+			pos_ += level + 2;
+			if (pos_ < n_ && text_[pos_] == '\r' && pos_ + 1 < n_ && text_[pos_ + 1] == '\n') pos_++;
+			if (pos_ < n_ && text_[pos_] == '\n') {
+				line_++;
+				pos_++;
+			}
+			size_t start = pos_;
+			size_t end = FindBracketClose(level);
+			ast.AddArg(text_.substr(start, end - start), ArgKind::Bracket);
+			return true;
+		}
+
+		// "#[[ ... ]]" bracket comment or "#" line comment; pos_ is at '#'.
+		void SkipComment() {
+			int level = BracketLevel(pos_ + 1);
+			if (level >= 0) {
+				pos_ += level + 3;
+				FindBracketClose(level);
+				return;
+			}
+			pos_ = Scanner::template FindAny<'\n'>(text_.data(), pos_, n_);
+		}
+
+		// Decodes the escape sequence at i into scratch_ and returns the index
+		// after it. "\<newline>" is a line continuation inside quoted args;
+		// "\;" is kept as written so list splitting can tell it from a ';'.
+		size_t AppendEscape(size_t i, bool quoted) {
+			if (i + 1 >= n_) return n_;
+			char c = text_[i + 1];
+			if (quoted && c == '\r' && i + 2 < n_ && text_[i + 2] == '\n') {
+				line_++;
+				return i + 3;
+			}
+			if (c == '\n') {
+				line_++;
+				if (quoted) return i + 2;
+			}
+			switch (c) {
+			case 't': scratch_ += '\t'; break;
+			case 'n': scratch_ += '\n'; break;
+			case 'r': scratch_ += '\r'; break;
+			case ';': scratch_ += "\\;"; break;
+			default:
+				if (IsAlpha(c) || (c >= '0' && c <= '9')) {
+					if (error_.empty()) {
+						error_ = std::string("Invalid escape sequence \\") + c;
+						errorLine_ = line_;
+					}
+					scratch_ += '\\';
+				}
+				scratch_ += c;
+				break;
+			}
+			return i + 2;
+		}
+
+		// Quoted argument; pos_ is at the opening '"'. Never split on ';'.
+		void ReadQuoted(AST& ast) {
+			size_t start = ++pos_;
+			size_t runStart = start;
+			size_t i = start;
+			bool copying = false;
+			while ((i = Scanner::template FindAny<'"', '\\', '\n'>(text_.data(), i, n_)) < n_ && text_[i] != '"') {
+				if (text_[i] == '\n') {
+					line_++;
+					i++;
+					continue;
+				}
+				if (!copying) {
+					scratch_.assign(text_.data() + start, i - start);
+					copying = true;
+				}
+				else {
+					scratch_.append(text_.data() + runStart, i - runStart);
+				}
+				i = runStart = AppendEscape(i, true);
+			}
+			size_t end = i < n_ ? i : n_;
+			if (copying) {
+				scratch_.append(text_.data() + runStart, end - runStart);
+				ast.AddArg(ast.Store(scratch_), ArgKind::Quoted);
+			}
+			else {
+				ast.AddArg(text_.substr(start, end - start), ArgKind::Quoted);
+			}
+			pos_ = i < n_ ? i + 1 : n_;
+		}
+
+		// Skips a legacy "..." run inside an unquoted arg (a"b c"d); the quotes
+		// and everything between them are kept as written.
+		size_t SkipLegacyQuote(size_t i) {
+			i++;
+			while ((i = Scanner::template FindAny<'"', '\\', '\n'>(text_.data(), i, n_)) < n_) {
+				char c = text_[i];
+				if (c == '"') return i + 1;
+				if (c == '\n') line_++;
+				else if (i + 1 < n_ && text_[++i] == '\n') line_++;
+				i++;
+			}
+			return n_;
+		}
+
+		// Unquoted argument, split into list elements on unescaped ';'. Empty
+		// elements are dropped, as CMake does for unquoted args.
+		void ReadUnquoted(AST& ast) {
+			size_t elemStart = pos_;
+			size_t runStart = pos_;
+			size_t i = pos_;
+			bool copying = false;
+
+			auto finish = [&](size_t end) {
+				if (copying) {
+					scratch_.append(text_.data() + runStart, end - runStart);
+					if (!scratch_.empty())
+						ast.AddArg(ast.Store(scratch_));
+					copying = false;
+				}
+				else if (end > elemStart) {
+					ast.AddArg(text_.substr(elemStart, end - elemStart));
+				}
+			};
+
+			while ((i = Scanner::template FindAny<' ', '\t', '\n', '\r', '\v', '\f', '(', ')', '#', '"', '\\', ';'>(text_.data(), i, n_)) < n_) {
+				char c = text_[i];
+				if (c == ';') {
+					finish(i);
+					elemStart = runStart = ++i;
+				}
+				else if (c == '"') {
+					i = SkipLegacyQuote(i);
+				}
+				else if (c == '\\') {
+					if (!copying) {
+						scratch_.assign(text_.data() + elemStart, i - elemStart);
+						copying = true;
+					}
+					else {
+						scratch_.append(text_.data() + runStart, i - runStart);
+					}
+					i = runStart = AppendEscape(i, false);
+				}
+				else {
+					break;
+				}
+			}
+			if (i > n_) i = n_;
+			finish(i);
+			pos_ = i;
+		}
+	};
+
+	using CmakeLexer = BasicCmakeLexer<>;
+}
\ No newline at end of file
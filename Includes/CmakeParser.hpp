@@ -2,17 +2,38 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <cwctype>
 #include <algorithm>
-#include <windows.h>
+#include <deque>
+#include <queue>
+#include "Platform.hpp"
 #include <filesystem>
 #include "CommandGenerator.hpp"
+#include "BuildPlanExporter.hpp"
 #include "RspFileGenerator.hpp"
+#include "DependencyTracker.hpp"
+#include "FileWatcher.hpp"
+#include "ObjectCache.hpp"
+#include "Trace.hpp"
+#include "LogWriter.hpp"
+#include "BuildLog.hpp"
+#include "BuildOptions.hpp"
+#include "JobScheduler.hpp"
+#include "StageGraph.hpp"
+#include "SpscQueue.hpp"
+#include "ProcessReactor.hpp"
 #include "ProjectModel.hpp"
-#include "ProcessRunGuard.h"
+#include "MappedFile.hpp"
+#include "Ast.hpp"
+#include "CmakeLexer.hpp"
+#include "VariableResolver.hpp"
+#include "ListFileTree.hpp"
+#include "ModelCache.hpp"
+#include "ProcessRunner.hpp"
 #include "ThreadPool.h"
 #include "Task.h"
 #include "HeaderHelpers.h"
@@ -27,252 +48,287 @@ namespace cmakeparser {
 		return !ec;
 	};
 
-	struct Command {
-		std::wstring name;
-		std::wstring raw_args;
-		std::vector<std::wstring> args;
-		int line_start = -1;
-		int line_end = -1;
-
-	public:
-		const std::wstring GenerateCommand() {
-
-		};
-	};
-
-	class AST {
-	public:
-		void AddCommand(Command&& cmd) { commands_.push_back(std::move(cmd)); }
-		const std::vector<Command>& Commands() const { return commands_; }
-	private:
-		std::vector<Command> commands_;
-	};
-
-
 	class CmakeParser {
 	public:
-		explicit CmakeParser(bool clearBuild, std::function<void(const wchar_t*, const wchar_t* logFile, bool, bool)> callback = nullptr) : callback_(callback), clearDir_(clearBuild) {
+		explicit CmakeParser(bool clearBuild, std::function<void(const wchar_t*, const wchar_t* logFile, bool, bool)> callback = nullptr) : callback_(callback), log_(callback), clearDir_(clearBuild) {
 		}
 		bool Parse(const std::wstring& path)
 		{
+			TraceScope trace(tracer_, L"parse", "parse");
 			Reset();
 
-			std::string utf8;
+			// An unchanged project skips reading and evaluating the list files.
+			ModelCache cache(path);
+			bool cached = false;
 			{
-				std::ifstream ifs(path, std::ios::binary);
-				if (!ifs) {
+				TraceScope load(tracer_, L"model cache load", "parse");
+				cached = cache.Load(model_, basePath_);
+				// PrepareBuildDirs would silently recreate a BASE_DIR that is gone;
+				// the cold path is the one that rejects it.
+				std::error_code ec;
+				if (cached && !std::filesystem::is_directory(basePath_, ec)) {
+					cached = false;
+					model_ = {};
+					basePath_.clear();
+				}
+				load.Args().Add("hit", cached ? 1 : 0);
+			}
+			if (cached) {
+				listFiles_ = cache.Inputs();
+				SetBaseDir(basePath_);
+			}
+			else {
+				{
+					TraceScope lex(tracer_, L"lex list files", "parse");
+					root_ = tree_.Load(path, Seeds());
+					lex.Args().Add("files", (int64_t)tree_.Size());
+				}
+				for (auto& file : tree_.Files())
+					listFiles_.push_back(file.path);
+				if (!root_->ok) {
 					last_error_ = L"Cannot open file";
 					return false;
 				}
-				std::ostringstream ss;
-				ss << ifs.rdbuf();
-				utf8 = ss.str();
-			}
 
-			text_ = Utf8ToWide(utf8);
+				if (root_->file.Size() == 0) {
+					last_error_ = L"Empty file";
+					return false;
+				}
 
-			if (text_.empty()) {
-				last_error_ = L"UTF-8 decode failed";
-				return false;
+				bool result = false;
+				{
+					TraceScope build(tracer_, L"BuildModel", "parse");
+					result = BuildModel();
+				}
+				if (!result) return result;
+				TraceScope save(tracer_, L"model cache save", "parse");
+				cache.Save(tree_, resolver_.EnvReads(), model_, basePath_);
 			}
 
-			pos_ = 0;
-			line_ = 1;
-			n_ = (int)text_.size();
-
-			ParseCommands();
-			auto result = BuildModel();
-			if (!result) return result;
-
 			if (clearDir_) {
 				auto& dir = GetBuildPath();
-				std::filesystem::remove_all(dir);
+				ClearBuildDir(dir);
 				std::filesystem::create_directories(dir);
 			}
 
-			SetBaseDir(basePath_);
+			PrepareBuildDirs();
 
 			return true;
 		}
 
 		void ConsoleLog(std::wostream& os = std::wcout) const {
 			os << L"CMake parse result\n";
-			for (const auto& c : ast_.Commands()) {
-				os << L"[" << c.name << L"] ";
-				for (auto& a : c.args) os << a << L" ";
+			const auto& ast = GetAST();
+			for (const auto& c : ast.Commands()) {
+				os << L"[" << platform::Utf8ToWide(c.name) << L"] ";
+				for (auto& a : ast.Args(c)) os << platform::Utf8ToWide(a) << L" ";
 				os << L"\n";
 			}
 		}
 
-		int Build(const bool isFullLog, const HANDLE& logFileHandle) {
-			logFileHandle_ = logFileHandle;
-			auto result = GetModel();
-			auto commands = GetAST();
+		int Build(const bool isFullLog, const platform::FileHandle& logFileHandle) {
+			log_.SetFile(logFileHandle);
+			const auto& result = GetModel();
 			RspFileGenerator rspGenerator(result, GetRspPath());
-			CommandGenerator generator(result, GetBasePath() + L"/NinjaBuilder/tools/gcc-arm-none-eabi/bin/", GetM3Path() + L"/src/mdk-arm/", GetObjPath());
-			auto objcopy = GetBasePath() + L"/tools/gcc-arm-none-eabi/bin/arm-none-eabi-objcopy.exe";
+			rspGenerator.SetTracer(tracer_.Enabled() ? &tracer_ : nullptr);
+			CommandGenerator generator = MakeCommandGenerator();
+			auto objcopy = GetBasePath() + L"/tools/gcc-arm-none-eabi/bin/arm-none-eabi-objcopy" + platform::kExeSuffix;
 			ProcessRunGuard guard;
 
-			int ErrCode = 0;
-			std::vector<Task<ProcessRunGuardResult>> tasks;
-			std::atomic<size_t> indexBuild = (1);
-			std::vector<std::wstring> commands_;
-
-			while (generator.HasNext()) {
-				std::wstring command;
-				std::wstring rspFile;
-				if (rspGenerator.CreateNextRspFile(rspFile)) {
-					generator.Next(command, rspFile);
-					commands_.push_back(command);
-				}
-			}
-			CancellationToken token;
-			for (auto& command : commands_) {
-				Task<ProcessRunGuardResult> task(
-					[this, &guard, command, &isFullLog, &ErrCode, &indexBuild, &commands_, &tasks](CancellationToken tok) {
-						ProcessRunGuardResult result;
-
-						if (tok && tok->load()) {
-							result.code = -1;
-							return result;
-						}
-						guard.RunCommand(command, result);
-						if (tok && tok->load()) {
-							result.code = -1;
-							return result;
-						}
-						auto index = indexBuild.load(std::memory_order_acquire);
-						indexBuild.fetch_add(1, std::memory_order_relaxed);
-						if (result.code != 0) {
-
-							ErrCode = result.code;
-							if (!result.stderrText.empty()) {
-
-								if (tok && tok->load()) {
-									result.code = -1;
-									return result;
-								}
-
-								SetConsole(result.stderrText.c_str(), result.stderrText.c_str(), false);
-
-								if (result.code != 0) {
-									std::wstringstream ss;
-									ss << L"Failed with exit code: " << result.code << L"\n";
-									SetConsole(ss.str().c_str(), ss.str().c_str(), false);
-									CloseAll(tasks);
-									return result;
-								}
-								CloseAll(tasks);
-							}
-						}
-						else {
-							if (!result.stderrText.empty()) {
-
-								if (tok && tok->load()) {
-									result.code = -1;
-									return result;
-								}
-								SetConsole(result.stderrText.c_str(), result.stderrText.c_str(), false);
-
-								if (result.code != 0) {
-									std::wstringstream ss;
-									ss << L"Failed with exit code: " << result.code << L"\n";
-									SetConsole(ss.str().c_str(), ss.str().c_str(), false);
-									CloseAll(tasks);
-									return result;
-								}
-								CloseAll(tasks);
-							}
-							if (tok && tok->load()) {
-								result.code = -1;
-								return result;
-							}
-							std::wstringstream ss;
-							ss << L"[" << index << L" /" << commands_.size() << L"] " << result.command;
-
-							if (isFullLog) {
-								SetConsole(ss.str().c_str(), ss.str().c_str());
-							}
-							else {
-								std::wstringstream ss1;
-								ss1 << L"[" << index << L" /" << commands_.size() << L"] " << L" успешно!";
-								SetConsole(ss1.str().c_str(), ss.str().c_str());
-							}
-						}
-
-						return result;
-					},
-					0
-				);
-
-				task.Start();
-
-				tasks.push_back(std::move(task));
-			}
-
-			WaitAll(tasks);
-			if (ErrCode != 0) {
-				return ErrCode;
-			}
-
-			Task<int> task([&guard, this, &rspGenerator, &generator, isFullLog] {
-				SetConsole(L"Создание elf...", L"Создание elf...");
-
-				auto pathElf = GetBuildPath() + L"/MAIN.elf";
-				auto pathBin = GetBuildPath() + L"/MAIN.bin";
-				auto pathLinkFile = rspGenerator.CreateLinkRspFile(generator.GetLinks());
-				auto command = generator.CreateLinkCommand(pathLinkFile, pathElf);
-				auto commandBin = generator.CreateBinCommand(pathElf, pathBin);
-				{
-					ProcessRunGuardResult result;
-					guard.RunCommand(command, result);
-
-					if (result.success) {
-						if (isFullLog) {
-							SetConsole(result.command.c_str(), result.command.c_str());
-							SetConsole(L"Elf успешно создан!", L"Elf успешно создан!");
-						}
-						else {
-							SetConsole(L"Elf успешно создан!", result.command.c_str(), true, true);
-						}
+			size_t upToDate = 0;
+			size_t fromCache = 0;
+			size_t toCompile = 0;
+			ObjectCache objectCache(options_.cacheDir, options_.cacheMaxMb);
+			BuildLog buildLog;
+			buildLog.Load(GetBuildLogPath());
+			const uint64_t toolHash = BuildLog::ToolHash(generator.CompilerPath());
+			// Jobs go to the dispatcher as soon as they are generated, so the first
+			// compiler runs while the rest of the commands are still being planned.
+			// Sources that need no compile are taken off the progress total.
+			SpscQueue<CompileJob> queue(kCompileQueueDepth);
+			std::atomic<size_t> total{ result.SrcCount() };
+
+			auto pathElf = GetBuildPath() + L"/MAIN.elf";
+			auto pathBin = GetBuildPath() + L"/MAIN.bin";
+			auto pathHex = GetBuildPath() + L"/MAIN.hex";
+			std::wstring pathLinkFile;
+			std::atomic<bool> relinked{ false };
+
+			StageGraph graph;
+			graph.SetTracer(tracer_.Enabled() ? &tracer_ : nullptr);
+			auto generate = graph.Add(L"generate", [&] {
+				int code = 0;
+				auto planStart = Tracer::Clock::now();
+				while (generator.HasNext()) {
+					CompileJob job;
+					std::wstring rspFile;
+					// The rsp must exist before a compile that names it is dispatched.
+					if (!rspGenerator.CreateNextRspFile(rspFile) || (rspGenerator.HasPending() && !rspGenerator.Flush())) {
+						code = -1;
+						break;
 					}
-					else {
-						SetConsole(result.stderrText.c_str(), result.stderrText.c_str(), false);
-						return (int)result.code;
-					}
-				}
-
-				{
-					ProcessRunGuardResult result;
-					guard.RunCommand(commandBin, result);
-
-					if (result.success) {
-						if (isFullLog) {
-							SetConsole(result.command.c_str(), result.command.c_str());
-							SetConsole(L"Bin успешно создан!", result.command.c_str(), true, true);
-						}
-						else {
-							SetConsole(L"Bin успешно создан!", result.command.c_str(), true, true);
+					if (!generator.Next(job, rspFile)) {
+						if (!generator.Error().empty()) {
+							code = -1;
+							break;
 						}
+						total--;
+						continue;
+					}
+					job.rspHash = rspGenerator.LastContentHash();
+					BuildLogEntry entry;
+					bool known = buildLog.Find(job.obj, entry);
+					if (!clearDir_ && known && IsUpToDate(job, entry, toolHash)) {
+						upToDate++;
+						total--;
+						continue;
 					}
-					else {
-						SetConsole(result.stderrText.c_str(), result.stderrText.c_str(), false);
-						return (int)result.code;
+					if (objectCache.Fetch(job, toolHash)) {
+						tracker_.Invalidate(job.obj);
+						tracker_.AddDepFile(job.depFile);
+						buildLog.Record(job.obj, job.commandHash, job.rspHash, toolHash, BuildLog::FileTime(job.obj), known ? entry.durationMs : 0, known ? entry.peakRssMb : 0);
+						fromCache++;
+						total--;
+						continue;
 					}
+					// gcc must create new files, not rewrite ones hardlinked into the object cache.
+					std::error_code ec;
+					std::filesystem::remove(job.obj, ec);
+					std::filesystem::remove(job.depFile, ec);
+					job.expectedMs = known && entry.durationMs != 0 ? entry.durationMs : UINT32_MAX;
+					job.expectedRssMb = known ? entry.peakRssMb : 0;
+					if (!queue.Push(std::move(job)))
+						break;
+					toCompile++;
 				}
-
+				queue.Close();
+
+				tracer_.Span(L"plan", "build", planStart, Tracer::Clock::now(), TraceArgs()
+					.Add("up_to_date", (int64_t)upToDate).Add("from_cache", (int64_t)fromCache).Add("to_compile", (int64_t)toCompile));
+				if (upToDate > 0) {
+					std::wstringstream ss;
+					ss << L"Актуальных объектов: " << upToDate << L", к сборке: " << toCompile;
+					SetConsole(ss.str().c_str(), ss.str().c_str());
+				}
+				if (fromCache > 0) {
+					std::wstringstream ss;
+					ss << L"Взято из кэша объектов: " << fromCache;
+					SetConsole(ss.str().c_str(), ss.str().c_str());
+				}
+				return code;
+			});
+
+			auto compile = graph.Add(L"compile", [&] {
+				int code = CompileAll(queue, total, buildLog, objectCache, toolHash, isFullLog);
+				objectCache.Trim();
+				return code;
+			}, {}, true);
+
+			auto prepareLink = graph.Add(L"prepare-link", [&] {
+				pathLinkFile = rspGenerator.CreateLinkRspFile(generator.GetLinks());
+				if (pathLinkFile.empty())
+					return -1;
+				PrepareLinkOutputs();
 				return 0;
-				});
+			}, { generate });
+
+			auto link = graph.Add(L"link", [&] {
+				auto links = generator.GetLinks();
+				links.push_back(pathLinkFile);
+				bool nothingCompiled = toCompile == 0 && fromCache == 0;
+				if (!clearDir_ && nothingCompiled && tracker_.IsNewerThanAll(pathElf, links)) {
+					SetConsole(L"Elf актуален, линковка не требуется.", L"Elf актуален, линковка не требуется.");
+					return 0;
+				}
 
-			task.Start();
+				SetConsole(L"Создание elf...", L"Создание elf...");
+				relinked = true;
+				int code = RunOutputStep(guard, generator.CreateLinkCommand(pathLinkFile, pathElf), L"Elf успешно создан!", isFullLog);
+				tracker_.Invalidate(pathElf);
+				return code;
+			}, { compile, prepareLink });
+
+			graph.Add(L"bin", [&] {
+				if (!clearDir_ && !relinked && tracker_.IsNewerThanAll(pathBin, { pathElf }))
+					return 0;
+				int code = RunOutputStep(guard, generator.CreateBinCommand(pathElf, pathBin), L"Bin успешно создан!", isFullLog);
+				tracker_.Invalidate(pathBin);
+				return code;
+			}, { link });
+
+			graph.Add(L"hex", [&] {
+				if (!clearDir_ && !relinked && tracker_.IsNewerThanAll(pathHex, { pathElf }))
+					return 0;
+				int code = RunOutputStep(guard, generator.CreateHexCommand(pathElf, pathHex), L"Hex успешно создан!", isFullLog);
+				tracker_.Invalidate(pathHex);
+				return code;
+			}, { link });
+
+			int code = graph.Run();
+			if (tracer_.Enabled())
+				tracer_.Write(options_.tracePath);
+			log_.Flush();
+			return code;
+		}
 
-			Task<void> clear([&tasks, &commands_] {
-				tasks.clear();
-				commands_.clear();
-				});
-			clear.Start();
+		// Writes the files requested by --compile-commands and --ninja from the
+		// parsed model (and the rsp files they refer to); nothing is compiled.
+		int Export() {
+			// Relative paths in the model are relative to where Build would run gcc.
+			std::error_code ec;
+			auto cwd = std::filesystem::current_path(ec).wstring();
+			RspFileGenerator rspGenerator(model_, GetRspPath());
+			CommandGenerator generator = MakeCommandGenerator(cwd);
+			BuildPlanExporter exporter(generator, rspGenerator, cwd);
+			if (!exporter.Collect())
+				return -1;
+
+			if (!options_.compileCommandsPath.empty()) {
+				if (!exporter.WriteCompileCommands(options_.compileCommandsPath, options_.inlineRsp))
+					return -1;
+				std::wstringstream ss;
+				ss << L"compile_commands.json: " << exporter.Size() << L" -> " << options_.compileCommandsPath;
+				SetConsole(ss.str().c_str(), ss.str().c_str());
+			}
+			if (!options_.ninjaPath.empty()) {
+				if (!exporter.WriteNinja(options_.ninjaPath, GetBuildPath() + L"/MAIN.elf", GetBuildPath() + L"/MAIN.bin", GetBuildPath() + L"/MAIN.hex"))
+					return -1;
+				std::wstringstream ss;
+				ss << L"build.ninja: " << exporter.Size() << L" -> " << options_.ninjaPath;
+				SetConsole(ss.str().c_str(), ss.str().c_str());
+			}
+			log_.Flush();
+			return 0;
+		}
 
-			return task.Get();
+		// Parses and builds, then keeps the model, the dependency state and the
+		// thread pool alive and rebuilds whenever a watched file changes. A source
+		// or header recompiles only the objects that depend on it; a list file
+		// re-parses the model first. Runs until the process is stopped.
+		[[noreturn]] void Watch(const std::wstring& path, const bool isFullLog, const platform::FileHandle& logFileHandle) {
+			FileWatcher watcher;
+			tracker_.RecordInputDirs(true);
+			bool parsed = Parse(path);
+			if (parsed)
+				Build(isFullLog, logFileHandle);
+			clearDir_ = false;
+
+			for (;;) {
+				if (!parsed)
+					std::wcerr << last_error_ << L": " << path << L"\n";
+				watcher.Watch(WatchDirs());
+				SetConsole(L"Ожидание изменений...", L"Ожидание изменений...");
+
+				bool reparse = !parsed;
+				for (auto& changed : watcher.Wait()) {
+					tracker_.Invalidate(changed);
+					reparse = reparse || IsListFile(changed);
+				}
+				if (reparse)
+					parsed = Parse(path);
+				if (parsed)
+					Build(isFullLog, logFileHandle);
+			}
 		}
 
 		const std::wstring& GetBasePath() const { return basePath_; }
@@ -280,328 +336,462 @@ namespace cmakeparser {
 		const std::wstring& GetBuildPath() const { return buildPath_; }
 		const std::wstring& GetObjPath() const { return objPath_; }
 		const std::wstring& GetRspPath() const { return rspPath_; }
-		const AST& GetAST() const { return ast_; }
+		const std::wstring GetBuildLogPath() const { return buildPath_ + L"/.build_log"; }
+		const AST& GetAST() const {
+			static const AST empty;
+			return root_ != nullptr ? root_->ast : empty;
+		}
 		const ProjectModel& GetModel() const { return model_; }
 
+		// Benchmark hook: evaluates the list files lexed by the last cold
+		// Parse() into a fresh model again; no file is read or written.
+		bool EvaluateLexed() {
+			if (root_ == nullptr || !root_->ok)
+				return false;
+			model_ = {};
+			return BuildModel();
+		}
+
+		void SetOptions(const BuildOptions& options) {
+			options_ = options;
+			if (!options_.tracePath.empty())
+				tracer_.Enable();
+		}
+		const BuildOptions& GetOptions() const { return options_; }
+
 	private:
 		std::wstring basePath_;
 		std::wstring m3Path_;
 		std::wstring buildPath_;
 		std::wstring objPath_;
 		std::wstring rspPath_;
-		std::wstring text_;
-		int pos_ = 0;
-		int n_ = 0;
-		int line_ = 1;
 		bool clearDir_;
 
-		AST ast_;
+		ListFileTree tree_;
+		const ListFile* root_ = nullptr;
+		static constexpr int kMaxListDepth = 64;
+		// Generated jobs the dispatcher has not taken yet; the generator waits beyond that.
+		static constexpr size_t kCompileQueueDepth = 256;
 		ProjectModel model_;
+		VariableResolver resolver_;
+		// Every list file the model was built from, including missing optional includes.
+		std::vector<std::wstring> listFiles_;
+		DependencyTracker tracker_;
+		Tracer tracer_;
+		BuildOptions options_;
 		std::wstring last_error_;
-		HANDLE logFileHandle_ = INVALID_HANDLE_VALUE;
-		std::mutex g_logMutex_;
 		std::function<void(const wchar_t*, const wchar_t*, bool, bool)> callback_;
+		LogWriter log_;
 
 	private:
 
+		// With baseDir a relative toolchain dir is taken against it, for commands
+		// that are exported rather than run here.
+		CommandGenerator MakeCommandGenerator(const std::wstring& baseDir = L"") const {
+			auto tools = RspFileGenerator::Absolute(baseDir, GetBasePath() + L"/NinjaBuilder/tools/gcc-arm-none-eabi/bin/");
+			return CommandGenerator(model_, tools, GetM3Path() + L"/src/mdk-arm/", GetObjPath());
+		}
+
+		// Only derives the paths; Parse() creates the directories once the
+		// model is complete.
 		void SetBaseDir(const std::wstring& path) {
 			basePath_ = path;
 			m3Path_ = basePath_ + L"/NinjaBuilder/M3_CITY2";
 			buildPath_ = m3Path_ + L"/Build";
-
-			std::filesystem::create_directories(buildPath_);
 			rspPath_ = buildPath_ + L"/rsp";
 			objPath_ = buildPath_ + L"/obj";
-			if (std::filesystem::exists(rspPath_))
+		}
+
+		void PrepareBuildDirs() {
+			std::filesystem::create_directories(buildPath_);
+			if (clearDir_ && std::filesystem::exists(rspPath_))
 				std::filesystem::remove_all(rspPath_);
 
-			if (std::filesystem::exists(objPath_))
+			if (clearDir_ && std::filesystem::exists(objPath_))
 				std::filesystem::remove_all(objPath_);
 
 			std::filesystem::create_directories(rspPath_);
 			std::filesystem::create_directories(objPath_);
-		};
+		}
 
-		void SetConsole(const wchar_t* text, const wchar_t* fullText, bool seccuses = true, bool repeat = false) {
-			if (callback_ == nullptr) {
-				std::wcout << text << L"\n";
+		// Dispatches jobs as the generate stage produces them. Whatever has arrived
+		// is kept in a small window and the longest job in it starts first (LPT;
+		// objects without history count as longest), ties in source order.
+		int CompileAll(SpscQueue<CompileJob>& queue, const std::atomic<size_t>& total, BuildLog& buildLog, ObjectCache& objectCache, uint64_t toolHash, const bool isFullLog) {
+			std::atomic<int> ErrCode{ 0 };
+			std::atomic<size_t> indexBuild = (1);
+			JobScheduler scheduler(options_);
+			ProcessReactor reactor;
+			// Callbacks hold references to jobs, a deque never moves them.
+			std::deque<CompileJob> jobs;
+			auto longerFirst = [&jobs](size_t a, size_t b) {
+				return jobs[a].expectedMs < jobs[b].expectedMs || (jobs[a].expectedMs == jobs[b].expectedMs && a > b);
+			};
+			std::priority_queue<size_t, std::vector<size_t>, decltype(longerFirst)> window(longerFirst);
+			// Cache stores hash every input and link files into the cache; they
+			// run on the pool so the reactor thread goes back to its pipes.
+			std::mutex storesMutex;
+			std::vector<Task<void>> stores;
+			for (;;) {
+				CompileJob next;
+				if (window.empty()) {
+					if (!queue.Pop(next))
+						break;
+					jobs.push_back(std::move(next));
+					window.push(jobs.size() - 1);
+				}
+				while (queue.TryPop(next)) {
+					jobs.push_back(std::move(next));
+					window.push(jobs.size() - 1);
+				}
+
+				auto& job = jobs[window.top()];
+				window.pop();
+				size_t rssMb = scheduler.EstimateRssMb(job.expectedRssMb);
+				auto queued = Tracer::Clock::now();
+				if (!scheduler.Acquire(rssMb, ErrCode)) {
+					queue.Cancel();
+					break;
+				}
+				auto submitted = Tracer::Clock::now();
+				auto dispatched = BuildLog::FileTimeNow();
+
+				reactor.Submit(job.command,
+					[this, &job, isFullLog, &ErrCode, &indexBuild, &total, &buildLog, &objectCache, toolHash, &scheduler, rssMb, queued, submitted, dispatched, &storesMutex, &stores](ProcessRunGuardResult& result, const ProcessStats& stats) {
+						JobScheduler::Slot slot(scheduler, rssMb);
+						tracker_.Invalidate(job.obj);
+						if (tracer_.Enabled()) {
+							auto us = [](Tracer::Clock::duration d) { return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+							tracer_.SlotSpan(std::filesystem::path(job.source).filename().wstring(), "compile", stats.started, Tracer::Clock::now(), TraceArgs()
+								.Add("source", job.source)
+								.Add("slot_wait_us", us(submitted - queued))
+								.Add("queue_us", us(stats.started - submitted))
+								.Add("exit_code", (int64_t)result.code)
+								.Add("peak_rss_mb", (int64_t)stats.peakRssMb)
+								.Add("exit_thread", (int64_t)Tracer::ThreadId()));
+						}
+						auto index = indexBuild.fetch_add(1, std::memory_order_relaxed);
+						std::vector<LogLine> lines;
+
+						if (!result.stderrText.empty()) {
+							lines.push_back({ result.stderrText, result.stderrText, false });
+						}
+
+						if (result.code != 0) {
+							ErrCode = result.code;
+							std::wstringstream ss;
+							ss << L"Failed with exit code: " << result.code << L"\n";
+							lines.push_back({ ss.str(), ss.str(), false });
+							SetConsole(std::move(lines));
+							return;
+						}
+
+						buildLog.Record(job.obj, job.commandHash, job.rspHash, toolHash, BuildLog::FileTime(job.obj), stats.durationMs, stats.peakRssMb);
+						Task<void> store([this, &job, &objectCache, toolHash, dispatched] {
+							objectCache.Store(job, toolHash, dispatched);
+							tracker_.AddDepFile(job.depFile);
+						});
+						store.Start(TaskPriority::Normal, TaskBound::IOBound);
+						{
+							std::lock_guard<std::mutex> lk(storesMutex);
+							stores.push_back(std::move(store));
+						}
+
+						std::wstringstream ss;
+						ss << L"[" << index << L" /" << total.load() << L"] " << result.command;
+
+						if (isFullLog) {
+							lines.push_back({ ss.str(), ss.str() });
+						}
+						else {
+							std::wstringstream ss1;
+							ss1 << L"[" << index << L" /" << total.load() << L"] " << L" успешно!";
+							lines.push_back({ ss1.str(), ss.str() });
+						}
+						SetConsole(std::move(lines));
+					});
 			}
-			else {
-				callback_(text, fullText, seccuses, repeat);
+
+			reactor.WaitIdle();
+			WaitAll(stores);
+			buildLog.Save(GetBuildLogPath());
+			return ErrCode;
+		}
+
+		int RunOutputStep(ProcessRunGuard& guard, const std::wstring& command, const wchar_t* doneText, const bool isFullLog) {
+			ProcessRunGuardResult result;
+			guard.RunCommand(command, result);
+
+			if (result.success) {
+				std::vector<LogLine> lines;
+				if (isFullLog)
+					lines.push_back({ result.command, result.command });
+				lines.push_back({ doneText, result.command, true, true });
+				SetConsole(std::move(lines));
+				return 0;
 			}
+
+			SetConsole(result.stderrText.c_str(), result.stderrText.c_str(), false);
+			return result.code != 0 ? (int)result.code : -1;
 		}
 
-		void LogAppend(
-			const wchar_t* message)
-		{
-			if (logFileHandle_ == INVALID_HANDLE_VALUE)
-				return;
-			auto logHandle = logFileHandle_;
-			auto& mutex = g_logMutex_;
-			Task<void> task([&logHandle, &mutex, message] {
-				std::lock_guard<std::mutex> lk(mutex);
-
-				LARGE_INTEGER zero{};
-				if (!SetFilePointerEx(logHandle, zero, nullptr, FILE_END))
-					return;
-
-				auto out = stringHelper::ToStringBestEffort(message);
-				if (out.empty())
-					return;
-				DWORD written = 0;
-				if (!WriteFile(logHandle,
-					out.data(),
-					static_cast<DWORD>(out.size()),
-					&written,
-					nullptr) ||
-					written != out.size())
-				{
-					// ошибка записи
-				}
-				});
-			task.Start(TaskPriority::High, TaskBound::IOBound);
+		// The elf/bin/hex outputs and a -Map file from the link flags need their
+		// directories before the linker runs. The map itself is left alone: the
+		// link may be skipped, and ld overwrites it when it does run.
+		void PrepareLinkOutputs() {
+			std::error_code ec;
+			std::filesystem::create_directories(GetBuildPath(), ec);
+			for (auto id : model_.LinkFlags()) {
+				auto flag = model_.Str(id);
+				auto pos = flag.find(L"-Map=");
+				if (pos == std::wstring::npos)
+					continue;
+				std::filesystem::path map(flag.substr(pos + 5));
+				if (map.has_parent_path())
+					std::filesystem::create_directories(map.parent_path(), ec);
+			}
 		}
 
-		void Reset() {
-			text_.clear();
-			ast_ = {};
-			model_ = {};
-			pos_ = 0;
-			line_ = 1;
+		bool IsUpToDate(const CompileJob& job, const BuildLogEntry& entry, uint64_t toolHash) {
+			if (entry.commandHash != job.commandHash || entry.rspHash != job.rspHash || entry.toolHash != toolHash)
+				return false;
+			if (entry.mtime != BuildLog::FileTime(job.obj))
+				return false;
+			return tracker_.IsUpToDate(job.obj, job.depFile, { job.rsp });
 		}
 
-		void SkipSpaces() {
-			while (pos_ < n_ && iswspace(text_[pos_])) {
-				if (text_[pos_] == L'\n') line_++;
-				pos_++;
+		// Wipes the build directory but keeps the build log, so compile durations
+		// survive a clean build.
+		void ClearBuildDir(const std::wstring& dir) {
+			std::error_code ec;
+			auto keep = std::filesystem::path(GetBuildLogPath()).filename();
+			for (auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+				if (entry.path().filename() == keep)
+					continue;
+				std::filesystem::remove_all(entry.path(), ec);
 			}
 		}
 
-		std::wstring Utf8ToWide(const std::string& s) {
-			if (s.empty()) return {};
-
-			int size = MultiByteToWideChar(
-				CP_UTF8,
-				0,
-				s.data(),
-				(int)s.size(),
-				nullptr,
-				0
-			);
-
-			std::wstring out(size, 0);
-			MultiByteToWideChar(
-				CP_UTF8,
-				0,
-				s.data(),
-				(int)s.size(),
-				out.data(),
-				size
-			);
+		// Queued for the log writer thread; returns without waiting for the console.
+		void SetConsole(const wchar_t* text, const wchar_t* fullText, bool seccuses = true, bool repeat = false) {
+			log_.Post(LogLine{ text, fullText, seccuses, repeat });
+		}
 
-			return out;
+		// Lines of one compile: printed as a single block with --group-output,
+		// otherwise line by line like any other message.
+		void SetConsole(std::vector<LogLine> lines) {
+			if (options_.groupOutput) {
+				log_.Post(std::move(lines));
+				return;
+			}
+			for (auto& line : lines)
+				log_.Post(std::move(line));
 		}
 
-		bool IsIdentStart(wchar_t c) const {
-			return iswalpha(c) || c == L'_';
+		// Directories holding the list files, sources, include dirs, linker
+		// scripts and every depfile input of the last build.
+		std::vector<std::wstring> WatchDirs() {
+			std::set<std::wstring> dirs;
+			auto add = [&dirs](const std::filesystem::path& dir) {
+				std::error_code ec;
+				auto abs = std::filesystem::absolute(dir, ec).lexically_normal();
+				if (!abs.has_filename())
+					abs = abs.parent_path();
+				if (!ec && std::filesystem::is_directory(abs, ec))
+					dirs.insert(abs.wstring());
+			};
+
+			for (auto& file : listFiles_)
+				add(std::filesystem::path(file).parent_path());
+			std::set<ProjectModel::Id> srcDirs;
+			for (size_t i = 0; i < model_.SrcCount(); ++i) {
+				if (srcDirs.insert(model_.GetSrc(i).dir).second)
+					add(model_.Str(model_.GetSrc(i).dir));
+			}
+			for (auto id : model_.IncludeDirs())
+				add(model_.Str(id));
+			for (auto id : model_.LinkTFlags())
+				add(std::filesystem::path(model_.Str(id)).parent_path());
+			for (auto& dir : tracker_.InputDirs())
+				add(dir);
+			return { dirs.begin(), dirs.end() };
 		}
 
-		bool IsIdent(wchar_t c) const {
-			return iswalnum(c) || c == L'_' || c == L'-';
+		bool IsListFile(const std::wstring& path) const {
+			auto key = ListFileTree::Key(path);
+			return std::any_of(listFiles_.begin(), listFiles_.end(), [&key](const std::wstring& file) {
+				return ListFileTree::Key(file) == key;
+			});
 		}
 
-		std::wstring ReadIdent() {
-			std::wstring r;
-			while (pos_ < n_ && IsIdent(text_[pos_])) {
-				r += towlower(text_[pos_++]);
-			}
-			return r;
+		void Reset() {
+			tree_.Reset();
+			root_ = nullptr;
+			model_ = {};
+			resolver_.Reset();
+			listFiles_.clear();
+			// Rsp files may be rewritten for the new model.
+			tracker_.Clear();
 		}
 
-		std::wstring ReadParenBlock() {
-			std::wstring r;
-			int depth = 1;
-			while (pos_ < n_ && depth > 0) {
-				wchar_t c = text_[pos_++];
-				if (c == L'(') depth++;
-				else if (c == L')') {
-					depth--;
-					if (depth == 0) break;
-				}
-				r += c;
-			}
-			return r;
+		static std::wstring Widen(std::string_view s) {
+			return platform::Utf8ToWide(s);
 		}
 
-		std::vector<std::wstring> SplitArgs(const std::wstring& s) {
+		static std::vector<std::wstring> Widen(const std::vector<std::string>& values, size_t from = 0) {
 			std::vector<std::wstring> out;
-			std::wstring cur;
-			bool quoted = false;
-
-			for (wchar_t c : s) {
-				if (c == L'"') {
-					quoted = !quoted;
-					continue;
-				}
-				if (!quoted && iswspace(c)) {
-					if (!cur.empty()) {
-						out.push_back(cur);
-						cur.clear();
-					}
-				}
-				else cur += c;
-			}
-			if (!cur.empty()) out.push_back(cur);
+			out.reserve(values.size() > from ? values.size() - from : 0);
+			for (size_t i = from; i < values.size(); ++i)
+				out.push_back(Widen(values[i]));
 			return out;
 		}
 
-		void ParseCommands() {
-			while (pos_ < n_) {
-				SkipSpaces();
-				if (pos_ >= n_) break;
+		// Flag variables are command-line strings; list elements are joined by blanks.
+		static std::wstring JoinFlags(const std::vector<std::string>& values) {
+			std::string joined;
+			for (size_t i = 0; i < values.size(); ++i) {
+				if (i) joined += ' ';
+				joined += values[i];
+			}
+			return Widen(joined);
+		}
 
-				if (text_[pos_] == L'#') {
-					while (pos_ < n_ && text_[pos_] != L'\n') pos_++;
-					continue;
-				}
+		// CMAKE_SOURCE_DIR is the firmware tree under BASE_DIR, as laid out by SetBaseDir.
+		ListFileTree::Vars Seeds() const {
+			ListFileTree::Vars seeds;
+			if (!basePath_.empty())
+				seeds.emplace_back("BASE_DIR", platform::WideToUtf8(basePath_));
+			if (!m3Path_.empty())
+				seeds.emplace_back("CMAKE_SOURCE_DIR", platform::WideToUtf8(m3Path_));
+			return seeds;
+		}
 
-				if (!IsIdentStart(text_[pos_])) {
-					pos_++;
-					continue;
-				}
+		void SeedVariables() {
+			for (auto& [name, value] : Seeds())
+				resolver_.Set(name, value);
+		}
 
-				int ls = line_;
-				auto name = ReadIdent();
-				SkipSpaces();
-
-				if (pos_ < n_ && text_[pos_] == L'(') {
-					pos_++;
-					auto body = ReadParenBlock();
-					Command c;
-					c.name = name;
-					c.raw_args = body;
-					c.args = SplitArgs(body);
-					c.line_start = ls;
-					c.line_end = line_;
-					ast_.AddCommand(std::move(c));
-				}
-			}
+		// Relative paths in a subdirectory are taken from its source dir; the
+		// root directory keeps them as written.
+		std::wstring SourcePath(const std::string& value, const std::wstring& sourceDir) const {
+			auto path = Widen(value);
+			if (sourceDir == root_->sourceDir || !std::filesystem::path(path).is_relative())
+				return path;
+			return (std::filesystem::path(sourceDir) / path).wstring();
 		}
 
 		bool BuildModel() {
-			for (auto& c : ast_.Commands()) {
-				if (c.name == L"project" && !c.args.empty())
-					model_.AddProject(c.args[0], basePath_);
-				else if (c.name == L"set" && c.args.size() > 1)
+			resolver_.Reset();
+			SeedVariables();
+			resolver_.Set("CMAKE_CURRENT_SOURCE_DIR", platform::WideToUtf8(root_->sourceDir));
+			return Evaluate(*root_, root_->sourceDir, 0);
+		}
+
+		// Runs one list file in order; add_subdirectory() evaluates the child in
+		// its own variable scope, include() in the current one.
+		bool Evaluate(const ListFile& file, const std::wstring& sourceDir, int depth) {
+			if (depth > kMaxListDepth) {
+				last_error_ = L"add_subdirectory/include nesting is too deep: " + file.path;
+				std::wcerr << last_error_ << L"\n";
+				return false;
+			}
+			if (!file.error.empty()) {
+				last_error_ = file.error;
+				std::wcerr << last_error_ << L"\n";
+				return false;
+			}
+			resolver_.Set("CMAKE_CURRENT_LIST_DIR", platform::WideToUtf8(file.dir));
+
+			const auto& ast = file.ast;
+			std::vector<std::string> values;
+			for (auto& c : ast.Commands()) {
+				auto args = ast.Args(c);
+				auto kinds = ast.Kinds(c);
+				if (c.NameIs("set") && !args.empty())
 				{
-					model_.AddSet(c.args[0], { c.args.begin() + 1, c.args.end() });
-					if (c.args[0] == L"BASE_DIR") {
-						if (std::filesystem::exists(c.args[1]))
-							SetBaseDir(c.args[1]);
-						else
-							return false;
-					}
-					else if (c.args[0] == L"CMAKE_C_FLAGS") {
-						model_.AddCompileFlags(c.args[1]);
+					auto name = resolver_.Expand(args[0]);
+					if (args.size() == 1) {
+						resolver_.Unset(name);
+						continue;
 					}
-					else if (c.args[0] == L"CMAKE_EXE_LINKER_FLAGS") {
-						std::wstring out;
-						if (NormalizePath(c.args[1], GetM3Path(), out)) {
-							model_.AddLinkTFlags(out);
-						}
+					resolver_.ExpandArgs(args, kinds, 1, values);
+					resolver_.Set(name, values);
+					model_.AddSet(Widen(name), Widen(values));
+					if (name == "BASE_DIR") {
+						auto dir = values.empty() ? std::wstring() : Widen(values[0]);
+						if (std::filesystem::exists(dir))
+							SetBaseDir(dir);
 						else {
-							model_.AddLinkFlags(c.args[1]);
+							last_error_ = L"BASE_DIR does not exist: " + dir;
+							std::wcerr << last_error_ << L"\n";
+							return false;
 						}
+						SeedVariables();
 					}
-					else if (c.args[0] == L"CMAKE_ASM_FLAGS") {
-						model_.AddAsmFlags(c.args[1]);
+					else if (name == "CMAKE_C_FLAGS") {
+						model_.AddCompileFlags(JoinFlags(values));
 					}
-					else if (c.raw_args.size() >= 3 && c.raw_args.substr(0, 3) == L"SRC") {
-						for (int i = 1; i < c.args.size(); i++) {
-							model_.AddSrc(c.args[i], basePath_);
-						}
+					else if (name == "CMAKE_EXE_LINKER_FLAGS") {
+						model_.AddLinkFlags(JoinFlags(values));
 					}
-				}
-				else if ((c.name == L"add_executable" || c.name == L"add_library") && c.args.size() > 1)
-					model_.AddTarget(c.args[0], { c.args.begin() + 1, c.args.end() });
-				else if (c.name == L"include_directories") {
-					std::wstring name = L"";
-					for (size_t i = 0; i < c.args.size(); ++i) {
-						name += c.args[i];
-						if (i + 1 < c.args.size())
-							name += L" ";
+					else if (name == "CMAKE_ASM_FLAGS") {
+						model_.AddAsmFlags(JoinFlags(values));
 					}
-					model_.AddIncludeDir(name, basePath_);
+					else if (name.starts_with("SRC")) {
+						for (auto& v : values)
+							model_.AddSrc(SourcePath(v, sourceDir));
+					}
+					continue;
 				}
-				else if (c.name == L"target_link_libraries")
-				{
-					auto lastArg = c.args[c.args.capacity()-1];
-					model_.AddLink(lastArg, m3Path_,L"${CMAKE_SOURCE_DIR}");
+				if (c.NameIs("unset") && !args.empty()) {
+					resolver_.Unset(resolver_.Expand(args[0]));
+					continue;
 				}
-			}
-			return true;
-		}
-
-		bool NormalizePath(const std::wstring& d, const std::wstring baseDir, std::wstring& out) const {
-			std::wstring result = d;
-			const std::wstring token = L"${CMAKE_SOURCE_DIR}";
-			size_t pos = 0;
-			bool find = false;
-			std::wstring outres;
-			while ((pos = result.find(token, pos) != std::wstring::npos)) {
-				outres.replace(pos - 1, token.length(), baseDir);
-				pos += baseDir.length();
-				std::wstring name;
-				find = ExtractFileName(d, name);
-				outres += L"/" + name;
-				out = outres;
-				break;
-			}
-			return find;
-		}
-
-		bool ExtractFileName(const std::wstring& s, std::wstring& out) const {
-			out.clear();
-			if (s.empty()) return false;
-
-			size_t tPos = s.find(L"-T");
-			if (tPos == std::wstring::npos) return false;
-
-			size_t i = tPos + 2;
-			while (i < s.size() && std::iswspace(static_cast<wint_t>(s[i]))) ++i;
-			if (i >= s.size()) return false;
-
-			while (i < s.size() && (s[i] == L'\\' || s[i] == L'"' || s[i] == L'\'')) ++i;
-			if (i >= s.size()) return false;
-
-			size_t start = i;
-			size_t end = start;
-			while (end < s.size() && !std::iswspace(static_cast<wint_t>(s[end]))) ++end;
 
-			if (end <= start) return false;
-
-			while (end > start && (s[end - 1] == L'\\' || s[end - 1] == L'"' || s[end - 1] == L'\'')) --end;
-			if (end <= start) return false;
-
-			std::wstring fullPath = s.substr(start, end - start);
-			size_t lastSlash = fullPath.find_last_of(L"/\\");
-			if (lastSlash == std::wstring::npos) {
-				size_t rb = fullPath.find_last_of(L'}');
-				if (rb != std::wstring::npos && rb + 1 < fullPath.size()) {
-					out = fullPath.substr(rb + 1);
+				resolver_.ExpandArgs(args, kinds, 0, values);
+				if (c.NameIs("add_subdirectory") && !values.empty()) {
+					auto path = ListFileTree::ResolveListFile(false, Widen(values[0]), sourceDir);
+					auto child = tree_.Get(path, ListFileTree::DirOf(path));
+					if (child == nullptr) {
+						last_error_ = L"Cannot open file: " + path;
+						std::wcerr << last_error_ << L"\n";
+						return false;
+					}
+					resolver_.PushScope();
+					resolver_.Set("CMAKE_CURRENT_SOURCE_DIR", platform::WideToUtf8(child->dir));
+					bool ok = Evaluate(*child, child->dir, depth + 1);
+					resolver_.PopScope();
+					if (!ok)
+						return false;
 				}
-				else {
-					out = fullPath;
+				else if (c.NameIs("include") && !values.empty()) {
+					auto path = ListFileTree::ResolveListFile(true, Widen(values[0]), sourceDir);
+					auto child = tree_.Get(path, sourceDir);
+					if (child == nullptr) {
+						if (std::find(values.begin(), values.end(), "OPTIONAL") != values.end())
+							continue;
+						last_error_ = L"Cannot open file: " + path;
+						std::wcerr << last_error_ << L"\n";
+						return false;
+					}
+					if (!Evaluate(*child, sourceDir, depth + 1))
+						return false;
+					resolver_.Set("CMAKE_CURRENT_LIST_DIR", platform::WideToUtf8(file.dir));
+				}
+				else if (c.NameIs("project") && !values.empty())
+					model_.AddProject(Widen(values[0]));
+				else if ((c.NameIs("add_executable") || c.NameIs("add_library")) && values.size() > 1)
+					model_.AddTarget(Widen(values[0]), Widen(values, 1));
+				else if (c.NameIs("include_directories")) {
+					for (auto& v : values)
+						model_.AddIncludeDir(SourcePath(v, sourceDir));
+				}
+				else if (c.NameIs("target_link_libraries") && !values.empty())
+				{
+					model_.AddLink(Widen(values.back()));
 				}
 			}
-			else {
-				out = fullPath.substr(lastSlash + 1);
-			}
-
-			if (!out.empty() && (out.front() == L'"' || out.front() == L'\'')) out.erase(out.begin());
-			while (!out.empty() && (out.back() == L'\\' || out.back() == L'"' || out.back() == L'\'')) out.pop_back();
-
-			return !out.empty();
+			return true;
 		}
 	};
 
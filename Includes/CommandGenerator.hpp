@@ -3,19 +3,37 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <iostream>
+#include <filesystem>
 #include <cwctype>
 
 #include "ProjectModel.hpp"
+#include "Hash.hpp"
+#include "Platform.hpp"
 
 namespace cmakeparser {
 
+	struct CompileJob {
+		std::wstring source;
+		std::wstring obj;
+		std::wstring depFile;
+		std::wstring rsp;
+		std::wstring command;
+		uint64_t commandHash = 0;
+		uint64_t rspHash = 0;
+		uint32_t expectedMs = 0;
+		uint32_t expectedRssMb = 0;
+	};
+
 	class CommandGenerator {
 	public:
 		explicit CommandGenerator(
 			const ProjectModel& model,
 			const std::wstring& pathGcc, const std::wstring& pathArm, const std::wstring& buildPath)
-			: model_(model), pathGcc_(pathGcc + L"arm-none-eabi-gcc.exe"), patheEabild(L"arm-none-eabi-ld.exe"), buildPath_(buildPath), pathGObj_(pathGcc + L"arm-none-eabi-objcopy.exe"), pathArm_(pathArm)
+			: model_(model), pathGcc_(pathGcc + L"arm-none-eabi-gcc" + platform::kExeSuffix), patheEabild(std::wstring(L"arm-none-eabi-ld") + platform::kExeSuffix), buildPath_(buildPath), pathGObj_(pathGcc + L"arm-none-eabi-objcopy" + platform::kExeSuffix), pathArm_(pathArm)
 		{
+			compilePrefix_ = quote_w(pathGcc_) + L" @";
 		}
 
 		bool HasNext() const {
@@ -23,18 +41,70 @@ namespace cmakeparser {
 		}
 
 		bool Next(std::wstring& out, std::wstring& pathRsp) {
+			CompileJob job;
+			if (!Next(job, pathRsp))
+				return false;
+			out = std::move(job.command);
+			return true;
+		}
+
+		// False when the source gets no job: a repeated SRC entry (skipped with a
+		// warning) or an object name clash between two different sources, which
+		// sets Error() and must stop the build.
+		bool Next(CompileJob& job, const std::wstring& pathRsp) {
 			if (!HasNext())
 				return false;
 
-			auto file = model_.GetSrcPathC(index_++);
-			std::wstring fileName = std::filesystem::path(file).filename().wstring();
-			std::wstring fileObjName = buildPath_ + L"/" + fileName + L".obj";
-			std::wstring fileObjDName = buildPath_ + L"/" + fileName + L".obj.d";
-			out = quote_w(pathGcc_) +  L" @" + quote_w(pathRsp) + L" -MD -MT " + quote_w(fileObjName) + L" -MF " + quote_w(fileObjDName) + L" -o " + quote_w(fileObjName) + L" -c " + quote_w(file);
+			auto src = model_.GetSrc(index_++);
+			std::wstring file;
+			model_.AppendPath(file, src);
+			std::wstring key = SourceKey(file);
+			std::wstring stem = ObjectStem(file, key);
+			auto [it, added] = objects_.emplace(stem, file);
+			if (!added) {
+				if (SourceKey(it->second) == key) {
+					std::wcerr << L"Warning: duplicate source skipped: " << file << L"\n";
+					return false;
+				}
+				error_ = L"Object name collision: " + it->second + L" and " + file;
+				std::wcerr << error_ << L"\n";
+				return false;
+			}
+
+			std::wstring fileObjName = buildPath_ + L"/" + stem + L".obj";
+			std::wstring fileObjDName = fileObjName + L".d";
+			auto objQuoted = quote_w(fileObjName);
+			job.source = file;
+			job.obj = fileObjName;
+			job.depFile = fileObjDName;
+			job.rsp = pathRsp;
+
+			// Compiler and source come pre-quoted, the object path is quoted once.
+			auto& cmd = job.command;
+			cmd.clear();
+			cmd.reserve(compilePrefix_.size() + pathRsp.size() + 3 * objQuoted.size() + file.size() + 48);
+			AppendCompile(cmd, pathRsp, objQuoted, fileObjDName);
+			model_.AppendQuotedPath(cmd, src);
+			job.commandHash = HashString(job.command);
 			link_.push_back(fileObjName);
 			return true;
 		}
 
+		// The command for a job whose paths were changed after Next(), such as
+		// an exported job with its paths made absolute.
+		std::wstring CommandFor(const CompileJob& job) {
+			std::wstring cmd;
+			AppendCompile(cmd, job.rsp, quote_w(job.obj), job.depFile);
+			cmd += quote_w(job.source);
+			return cmd;
+		}
+
+		// The job's command with the @rsp argument replaced by the given arguments.
+		std::wstring InlineRsp(const CompileJob& job, const std::wstring& args) {
+			size_t skip = compilePrefix_.size() + quote_w(job.rsp).size();
+			return quote_w(pathGcc_) + L" " + args + job.command.substr(skip);
+		}
+
 		std::wstring CreateLinkCommand(std::wstring link_rsp, std::wstring pathOutput) {
 			return quote_w(pathGcc_) + L" @" + quote_w(link_rsp) + L" -o " + quote_w(pathOutput);
 		}
@@ -48,9 +118,15 @@ namespace cmakeparser {
 
 		void Reset() {
 			index_ = 0;
+			objects_.clear();
+			error_.clear();
 		}
 
+		// Set once two different sources have mapped to the same object.
+		const std::wstring& Error() const { return error_; }
+
 		std::vector<std::wstring> GetLinks() { return link_; }
+		const std::wstring& CompilerPath() const { return pathGcc_; }
 
 	private:
 		const ProjectModel& model_;
@@ -61,6 +137,37 @@ namespace cmakeparser {
 		const std::wstring buildPath_;
 		const std::wstring pathArm_;
 		const std::wstring pathGObj_;
+		std::wstring compilePrefix_;
+
+		// Normalized source path; paths differing only in case name the same
+		// file on Windows.
+		static std::wstring SourceKey(const std::wstring& file) {
+			auto key = std::filesystem::path(file).lexically_normal().generic_wstring();
+#ifdef _WIN32
+			for (auto& c : key)
+				c = (wchar_t)std::towlower(c);
+#endif
+			return key;
+		}
+
+		// Sources with the same file name in different directories must not share
+		// an object, so the name carries the 64-bit hash of the source key.
+		static std::wstring ObjectStem(const std::wstring& file, const std::wstring& key) {
+			return std::filesystem::path(file).filename().wstring() + L"-" + ToHex(HashString(key));
+		}
+
+		// Everything up to the source: compiler, @rsp, depfile and object.
+		void AppendCompile(std::wstring& cmd, const std::wstring& pathRsp, const std::wstring& objQuoted, const std::wstring& depFile) {
+			cmd += compilePrefix_;
+			cmd += quote_w(pathRsp);
+			cmd += L" -MD -MT ";
+			cmd += objQuoted;
+			cmd += L" -MF ";
+			cmd += quote_w(depFile);
+			cmd += L" -o ";
+			cmd += objQuoted;
+			cmd += L" -c ";
+		}
 
 		std::wstring quote_w(const std::wstring& s) {
 			if (s.find_first_of(L" \t\"") == std::wstring::npos) return s;
@@ -73,6 +180,9 @@ namespace cmakeparser {
 		}
 
 		std::vector<std::wstring> link_;
+		// Object stem -> the source it was given to.
+		std::unordered_map<std::wstring, std::wstring> objects_;
+		std::wstring error_;
 
 
 	};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace cmakeparser {
+
+	class DependencyTracker
+	{
+	public:
+		// Object is up to date when it exists, its depfile parses and no input
+		// (source, headers from the depfile, extraInputs) is newer than it.
+		bool IsUpToDate(const std::wstring& objPath, const std::wstring& depPath, const std::vector<std::wstring>& extraInputs) {
+			std::filesystem::file_time_type objTime;
+			if (!GetTime(objPath, objTime))
+				return false;
+
+			std::vector<std::filesystem::path> deps;
+			if (!ParseDepFile(depPath, deps) || deps.empty())
+				return false;
+			if (recordDirs_)
+				RecordDirs(deps);
+
+			for (auto& d : deps) {
+				std::filesystem::file_time_type t;
+				if (!GetTime(d, t) || t > objTime)
+					return false;
+			}
+
+			return IsNewerThanAll(objPath, extraInputs);
+		}
+
+		bool IsNewerThanAll(const std::wstring& outputPath, const std::vector<std::wstring>& inputs) {
+			std::filesystem::file_time_type outTime;
+			if (!GetTime(outputPath, outTime))
+				return false;
+
+			for (auto& in : inputs) {
+				std::filesystem::file_time_type t;
+				if (!GetTime(in, t) || t > outTime)
+					return false;
+			}
+			return true;
+		}
+
+		// Forget cached timestamps of files that are rewritten during the build.
+		void Invalidate(const std::wstring& path) {
+			std::lock_guard<std::mutex> lk(mutex_);
+			mtimes_.erase(Key(path));
+		}
+
+		void Clear() {
+			std::lock_guard<std::mutex> lk(mutex_);
+			mtimes_.clear();
+			inputDirs_.clear();
+		}
+
+		// Watch mode: remember the directory of every depfile input seen by
+		// IsUpToDate() or AddDepFile(), headers in subdirectories included.
+		void RecordInputDirs(bool on) { recordDirs_ = on; }
+
+		// Inputs of a freshly compiled object.
+		void AddDepFile(const std::wstring& depPath) {
+			if (!recordDirs_)
+				return;
+			std::vector<std::filesystem::path> deps;
+			if (ParseDepFile(depPath, deps))
+				RecordDirs(deps);
+		}
+
+		std::vector<std::wstring> InputDirs() {
+			std::lock_guard<std::mutex> lk(mutex_);
+			return { inputDirs_.begin(), inputDirs_.end() };
+		}
+
+		// Reads the first rule of a gcc -MD depfile: "target: dep dep \<newline> dep".
+		static bool ParseDepFile(const std::wstring& depPath, std::vector<std::filesystem::path>& deps) {
+			deps.clear();
+			std::ifstream ifs(std::filesystem::path(depPath), std::ios::binary);
+			if (!ifs)
+				return false;
+
+			std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+			bool inDeps = false;
+			std::string cur;
+			size_t i = 0;
+			size_t n = data.size();
+
+			auto flush = [&]() {
+				if (!cur.empty()) {
+					if (inDeps)
+						deps.emplace_back(cur);
+					cur.clear();
+				}
+			};
+
+			while (i < n) {
+				char c = data[i];
+				if (c == '\\' && i + 1 < n) {
+					char next = data[i + 1];
+					if (next == '\n') { flush(); i += 2; continue; }
+					if (next == '\r' && i + 2 < n && data[i + 2] == '\n') { flush(); i += 3; continue; }
+					if (next == ' ' || next == '#') { cur += next; i += 2; continue; }
+					cur += c;
+					i++;
+					continue;
+				}
+				if (c == '$' && i + 1 < n && data[i + 1] == '$') {
+					cur += '$';
+					i += 2;
+					continue;
+				}
+				if (c == '\n' || c == '\r') {
+					flush();
+					if (inDeps)
+						break;
+					i++;
+					continue;
+				}
+				if (c == ' ' || c == '\t') {
+					flush();
+					i++;
+					continue;
+				}
+				if (!inDeps && c == ':' && (i + 1 >= n || data[i + 1] == ' ' || data[i + 1] == '\t' || data[i + 1] == '\n' || data[i + 1] == '\r')) {
+					cur.clear();
+					inDeps = true;
+					i++;
+					continue;
+				}
+				cur += c;
+				i++;
+			}
+			flush();
+			return inDeps;
+		}
+
+	private:
+		std::unordered_map<std::wstring, std::filesystem::file_time_type> mtimes_;
+		std::unordered_set<std::wstring> inputDirs_;
+		bool recordDirs_ = false;
+		std::mutex mutex_;
+
+		void RecordDirs(const std::vector<std::filesystem::path>& deps) {
+			std::lock_guard<std::mutex> lk(mutex_);
+			for (auto& d : deps)
+				inputDirs_.insert(std::filesystem::path(Key(d)).parent_path().wstring());
+		}
+
+		// Depfiles may name headers relative to the working directory; the
+		// watcher reports absolute paths, so both must map to the same entry.
+		static std::wstring Key(const std::filesystem::path& path) {
+			if (path.is_absolute())
+				return path.lexically_normal().wstring();
+			std::error_code ec;
+			return std::filesystem::absolute(path, ec).lexically_normal().wstring();
+		}
+
+		bool GetTime(const std::filesystem::path& path, std::filesystem::file_time_type& out) {
+			auto key = Key(path);
+			std::lock_guard<std::mutex> lk(mutex_);
+			auto it = mtimes_.find(key);
+			if (it != mtimes_.end()) {
+				out = it->second;
+				return true;
+			}
+
+			std::error_code ec;
+			out = std::filesystem::last_write_time(path, ec);
+			if (ec)
+				return false;
+			mtimes_.emplace(std::move(key), out);
+			return true;
+		}
+	};
+}
\ No newline at end of file
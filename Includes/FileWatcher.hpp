@@ -0,0 +1,176 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Platform.hpp"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cmakeparser {
+
+	// Reports files that change in a set of directories (not recursive). Linux
+	// uses inotify; elsewhere the directories are rescanned for size and mtime
+	// changes. Dot-files and subdirectories are ignored, so the build log and
+	// editor swap files do not wake the watcher.
+	class FileWatcher
+	{
+	public:
+		FileWatcher() {
+#ifndef _WIN32
+			fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+#endif
+		}
+
+		~FileWatcher() {
+#ifndef _WIN32
+			if (fd_ >= 0)
+				close(fd_);
+#endif
+		}
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// Replaces the watched set; directories that stay in it keep their watch.
+		void Watch(const std::vector<std::wstring>& dirs) {
+			std::unordered_set<std::wstring> wanted(dirs.begin(), dirs.end());
+#ifndef _WIN32
+			for (auto it = dirs_.begin(); it != dirs_.end();) {
+				if (wanted.count(it->second) == 0) {
+					inotify_rm_watch(fd_, it->first);
+					it = dirs_.erase(it);
+				}
+				else {
+					wanted.erase(it->second);
+					++it;
+				}
+			}
+			for (auto& dir : wanted) {
+				int wd = inotify_add_watch(fd_, platform::WideToUtf8(dir).c_str(),
+					IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB);
+				if (wd >= 0)
+					dirs_[wd] = dir;
+			}
+#else
+			for (auto it = snapshot_.begin(); it != snapshot_.end();) {
+				if (wanted.count(it->first) == 0)
+					it = snapshot_.erase(it);
+				else
+					++it;
+			}
+			for (auto& dir : wanted) {
+				if (snapshot_.count(dir) == 0)
+					snapshot_[dir] = Scan(dir);
+			}
+#endif
+		}
+
+		// Blocks until something changes, then collects changes until the
+		// directories have been quiet for kSettle, so a save that touches several
+		// files (or one file several times) is reported once.
+		std::vector<std::wstring> Wait() {
+			std::unordered_set<std::wstring> changed;
+			Collect(changed, -1);
+			while (Collect(changed, (int)kSettle.count())) {
+			}
+			return { changed.begin(), changed.end() };
+		}
+
+	private:
+		static constexpr std::chrono::milliseconds kSettle{ 100 };
+
+		static bool Ignored(std::wstring_view name) {
+			return name.empty() || name.front() == L'.';
+		}
+
+#ifndef _WIN32
+		int fd_ = -1;
+		std::unordered_map<int, std::wstring> dirs_;
+
+		// Adds the changed paths to out; false when nothing arrived within timeoutMs.
+		bool Collect(std::unordered_set<std::wstring>& out, int timeoutMs) {
+			size_t before = out.size();
+			for (;;) {
+				pollfd p{ fd_, POLLIN, 0 };
+				int ready = poll(&p, 1, timeoutMs);
+				if (ready <= 0)
+					return out.size() != before;
+
+				alignas(inotify_event) char buf[4096];
+				ssize_t n = 0;
+				while ((n = read(fd_, buf, sizeof(buf))) > 0) {
+					for (char* ptr = buf; ptr < buf + n;) {
+						auto* ev = reinterpret_cast<inotify_event*>(ptr);
+						ptr += sizeof(inotify_event) + ev->len;
+						if ((ev->mask & IN_ISDIR) != 0 || ev->len == 0)
+							continue;
+						auto dir = dirs_.find(ev->wd);
+						auto name = platform::Utf8ToWide(ev->name);
+						if (dir == dirs_.end() || Ignored(name))
+							continue;
+						out.insert((std::filesystem::path(dir->second) / name).wstring());
+					}
+				}
+				if (out.size() != before)
+					return true;
+				// Only ignored entries changed; keep waiting for the same timeout.
+			}
+		}
+#else
+		struct Stamp {
+			uintmax_t size;
+			std::filesystem::file_time_type time;
+		};
+		using DirStamps = std::unordered_map<std::wstring, Stamp>;
+
+		static constexpr std::chrono::milliseconds kPoll{ 500 };
+		std::unordered_map<std::wstring, DirStamps> snapshot_;
+
+		static DirStamps Scan(const std::wstring& dir) {
+			DirStamps stamps;
+			std::error_code ec;
+			for (auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+				if (!entry.is_regular_file(ec) || Ignored(entry.path().filename().wstring()))
+					continue;
+				Stamp s{ entry.file_size(ec), entry.last_write_time(ec) };
+				stamps.emplace(entry.path().wstring(), s);
+			}
+			return stamps;
+		}
+
+		bool Collect(std::unordered_set<std::wstring>& out, int timeoutMs) {
+			size_t before = out.size();
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+			do {
+				std::this_thread::sleep_for(timeoutMs < 0 ? kPoll : std::chrono::milliseconds(timeoutMs));
+				for (auto& [dir, old] : snapshot_) {
+					auto now = Scan(dir);
+					for (auto& [path, s] : now) {
+						auto it = old.find(path);
+						if (it == old.end() || it->second.size != s.size || it->second.time != s.time)
+							out.insert(path);
+					}
+					for (auto& [path, s] : old) {
+						if (now.count(path) == 0)
+							out.insert(path);
+					}
+					old = std::move(now);
+				}
+			} while (out.size() == before && (timeoutMs < 0 || std::chrono::steady_clock::now() < deadline));
+			return out.size() != before;
+		}
+#endif
+	};
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cmakeparser {
+
+	constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+	constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+	inline uint64_t Fnv1a64(const void* data, size_t size, uint64_t seed = kFnvOffset) {
+		auto p = static_cast<const unsigned char*>(data);
+		uint64_t h = seed;
+		for (size_t i = 0; i < size; ++i) {
+			h ^= p[i];
+			h *= kFnvPrime;
+		}
+		return h;
+	}
+
+	inline uint64_t HashString(std::string_view s, uint64_t seed = kFnvOffset) {
+		return Fnv1a64(s.data(), s.size(), seed);
+	}
+
+	inline uint64_t HashString(std::wstring_view s, uint64_t seed = kFnvOffset) {
+		return Fnv1a64(s.data(), s.size() * sizeof(wchar_t), seed);
+	}
+
+	inline uint64_t HashCombine(uint64_t h, uint64_t v) {
+		return Fnv1a64(&v, sizeof(v), h);
+	}
+
+	inline std::wstring ToHex(uint64_t v, int digits = 16) {
+		static const wchar_t* hex = L"0123456789abcdef";
+		std::wstring out(digits, L'0');
+		for (int i = digits - 1; i >= 0; --i) {
+			out[i] = hex[v & 0xF];
+			v >>= 4;
+		}
+		return out;
+	}
+}
\ No newline at end of file
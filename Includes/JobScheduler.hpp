@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "Platform.hpp"
+
+#include "BuildOptions.hpp"
+
+namespace cmakeparser {
+
+	// Admits compile jobs one by one: at most jobs_ in flight, and while anything
+	// is running a new job also has to fit the load limit and the memory budget.
+	class JobScheduler
+	{
+	public:
+		static constexpr size_t kDefaultJobRssMb = 300;
+
+		explicit JobScheduler(const BuildOptions& options)
+			: jobs_(options.jobs), maxLoad_(options.maxLoad), maxRssMb_(options.maxRssMb)
+		{
+			if (jobs_ == 0)
+				jobs_ = std::thread::hardware_concurrency();
+			if (jobs_ == 0)
+				jobs_ = 4;
+			SystemLoad();
+		}
+
+		class Slot {
+		public:
+			Slot(JobScheduler& scheduler, size_t rssMb) : scheduler_(scheduler), rssMb_(rssMb) {}
+			~Slot() { scheduler_.Release(rssMb_); }
+			Slot(const Slot&) = delete;
+			Slot& operator=(const Slot&) = delete;
+		private:
+			JobScheduler& scheduler_;
+			size_t rssMb_;
+		};
+
+		// Blocks until the job may start; returns false once stop is raised.
+		bool Acquire(size_t rssMb, const std::atomic<int>& stop) {
+			std::unique_lock<std::mutex> lk(mutex_);
+			while (true) {
+				if (stop.load() != 0)
+					return false;
+				if (CanStart(rssMb)) {
+					running_++;
+					rssInFlightMb_ += rssMb;
+					return true;
+				}
+				cv_.wait_for(lk, std::chrono::milliseconds(kPollMs));
+			}
+		}
+
+		void Release(size_t rssMb) {
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				running_--;
+				rssInFlightMb_ -= rssMb;
+			}
+			cv_.notify_all();
+		}
+
+		size_t Jobs() const { return jobs_; }
+
+		// Peak RSS recorded for the object on a previous build, if any.
+		size_t EstimateRssMb(uint32_t recordedMb) const {
+			return recordedMb != 0 ? recordedMb : kDefaultJobRssMb;
+		}
+
+	private:
+		static constexpr int kPollMs = 100;
+
+		size_t jobs_;
+		double maxLoad_;
+		size_t maxRssMb_;
+		size_t running_ = 0;
+		size_t rssInFlightMb_ = 0;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+#ifdef _WIN32
+		unsigned long long prevIdle_ = 0;
+		unsigned long long prevTotal_ = 0;
+#endif
+
+		bool CanStart(size_t rssMb) {
+			if (running_ >= jobs_)
+				return false;
+			if (running_ == 0)
+				return true;
+			if (maxLoad_ > 0.0 && SystemLoad() >= maxLoad_)
+				return false;
+			if (maxRssMb_ > 0) {
+				if (rssInFlightMb_ + rssMb > maxRssMb_)
+					return false;
+				if (AvailableMemoryMb() < rssMb)
+					return false;
+			}
+			return true;
+		}
+
+#ifdef _WIN32
+		// Busy share of all cores since the previous sample, scaled to a
+		// loadavg-like number of busy cores.
+		double SystemLoad() {
+			FILETIME idle, kernel, user;
+			if (!GetSystemTimes(&idle, &kernel, &user))
+				return 0.0;
+			auto idleT = ToU64(idle);
+			auto total = ToU64(kernel) + ToU64(user);
+			auto dIdle = idleT - prevIdle_;
+			auto dTotal = total - prevTotal_;
+			prevIdle_ = idleT;
+			prevTotal_ = total;
+			if (dTotal == 0)
+				return 0.0;
+			double busy = 1.0 - (double)dIdle / (double)dTotal;
+			return busy * std::thread::hardware_concurrency();
+		}
+
+		static size_t AvailableMemoryMb() {
+			MEMORYSTATUSEX status{};
+			status.dwLength = sizeof(status);
+			if (!GlobalMemoryStatusEx(&status))
+				return (size_t)-1;
+			return (size_t)(status.ullAvailPhys / (1024 * 1024));
+		}
+
+		static unsigned long long ToU64(const FILETIME& ft) {
+			return ((unsigned long long)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+		}
+#else
+		double SystemLoad() {
+			double load[1];
+			if (getloadavg(load, 1) != 1)
+				return 0.0;
+			return load[0];
+		}
+
+		static size_t AvailableMemoryMb() {
+			long pages = sysconf(_SC_AVPHYS_PAGES);
+			long pageSize = sysconf(_SC_PAGESIZE);
+			if (pages < 0 || pageSize < 0)
+				return (size_t)-1;
+			return (size_t)((unsigned long long)pages * (unsigned long long)pageSize / (1024 * 1024));
+		}
+#endif
+	};
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Ast.hpp"
+#include "BuildLog.hpp"
+#include "CmakeLexer.hpp"
+#include "MappedFile.hpp"
+#include "Platform.hpp"
+#include "VariableResolver.hpp"
+#include "Task.h"
+
+namespace cmakeparser {
+
+	// A CMakeLists.txt or include()d .cmake file, lexed in place.
+	struct ListFile {
+		using Vars = std::vector<std::pair<std::string, std::string>>;
+
+		std::wstring path;
+		std::wstring dir;
+		// CMAKE_CURRENT_SOURCE_DIR the file is expected to run under.
+		std::wstring sourceDir;
+		MappedFile file;
+		AST ast;
+		bool ok = false;
+		// First syntax error, "path:line: message"; the file is not evaluated.
+		std::wstring error;
+		// Taken before the file is read, so an edit during the parse is seen as a change.
+		int64_t mtime = 0;
+		// Variables visible at the add_subdirectory()/include() site, used
+		// only to predict the paths this file pulls in.
+		Vars inherited;
+	};
+
+	// All list files reachable from the root through add_subdirectory() and
+	// include(). Files are found level by level and every level is read and
+	// lexed in parallel on the thread pool. Child paths are predicted with the
+	// variables set so far; a path the prediction missed is lexed on demand by
+	// Get() while the model is evaluated in CMake order.
+	class ListFileTree
+	{
+	public:
+		using Vars = ListFile::Vars;
+
+		const ListFile* Load(const std::wstring& rootPath, Vars seeds) {
+			Reset();
+			auto dir = DirOf(rootPath);
+			seeds.emplace_back("CMAKE_CURRENT_SOURCE_DIR", platform::WideToUtf8(dir));
+			std::vector<ListFile*> level{ Add(rootPath, dir, std::move(seeds)) };
+
+			while (!level.empty()) {
+				std::vector<std::vector<Pending>> found(level.size());
+				if (level.size() == 1) {
+					Lex(*level[0]);
+					Discover(*level[0], found[0]);
+				}
+				else {
+					std::vector<Task<void>> tasks;
+					tasks.reserve(level.size());
+					for (size_t i = 0; i < level.size(); ++i) {
+						Task<void> task([this, file = level[i], out = &found[i]] {
+							Lex(*file);
+							Discover(*file, *out);
+						});
+						task.Start();
+						tasks.push_back(std::move(task));
+					}
+					WaitAll(tasks);
+				}
+
+				// Registration happens here, on one thread, in include order.
+				std::vector<ListFile*> next;
+				for (auto& pending : found) {
+					for (auto& p : pending) {
+						if (index_.find(Key(p.path)) == index_.end())
+							next.push_back(Add(p.path, p.sourceDir, std::move(p.vars)));
+					}
+				}
+				level = std::move(next);
+			}
+			return &files_.front();
+		}
+
+		// Lexed file for a path, lexing it now if discovery did not predict it;
+		// nullptr when it cannot be read.
+		const ListFile* Get(const std::wstring& path, const std::wstring& sourceDir) {
+			auto it = index_.find(Key(path));
+			ListFile* file = nullptr;
+			if (it != index_.end()) {
+				file = &files_[it->second];
+			}
+			else {
+				file = Add(path, sourceDir, {});
+				Lex(*file);
+			}
+			return file->ok ? file : nullptr;
+		}
+
+		// add_subdirectory(dir) runs dir/CMakeLists.txt; include(name) takes a
+		// file, or name.cmake. Relative paths are taken from the current source dir.
+		static std::wstring ResolveListFile(bool include, const std::wstring& arg, const std::wstring& sourceDir) {
+			std::filesystem::path p(arg);
+			if (p.is_relative() && !sourceDir.empty())
+				p = std::filesystem::path(sourceDir) / p;
+			if (!include)
+				return (p / L"CMakeLists.txt").wstring();
+			std::error_code ec;
+			if (!p.has_extension() && !std::filesystem::exists(p, ec))
+				p += L".cmake";
+			return p.wstring();
+		}
+
+		static std::wstring DirOf(const std::wstring& path) {
+			std::error_code ec;
+			auto abs = std::filesystem::absolute(path, ec);
+			return (ec ? std::filesystem::path(path) : abs).lexically_normal().parent_path().wstring();
+		}
+
+		size_t Size() const { return files_.size(); }
+		const std::deque<ListFile>& Files() const { return files_; }
+
+		static std::wstring Key(const std::wstring& path) {
+			std::error_code ec;
+			auto abs = std::filesystem::absolute(path, ec);
+			return (ec ? std::filesystem::path(path) : abs).lexically_normal().generic_wstring();
+		}
+
+		void Reset() {
+			files_.clear();
+			index_.clear();
+		}
+
+	private:
+		struct Pending {
+			std::wstring path;
+			std::wstring sourceDir;
+			Vars vars;
+		};
+
+		std::deque<ListFile> files_;
+		std::unordered_map<std::wstring, size_t> index_;
+
+		ListFile* Add(const std::wstring& path, const std::wstring& sourceDir, Vars vars) {
+			index_.emplace(Key(path), files_.size());
+			auto& file = files_.emplace_back();
+			file.path = path;
+			file.dir = DirOf(path);
+			file.sourceDir = sourceDir;
+			file.inherited = std::move(vars);
+			return &file;
+		}
+
+		static void Lex(ListFile& file) {
+			file.mtime = BuildLog::FileTime(file.path);
+			file.ok = file.file.Open(file.path);
+			if (!file.ok)
+				return;
+			CmakeLexer lexer(file.file.View());
+			lexer.Lex(file.ast);
+			if (!lexer.Error().empty())
+				file.error = file.path + L":" + std::to_wstring(lexer.ErrorLine()) + L": " + platform::Utf8ToWide(lexer.Error());
+		}
+
+		// Replays set() with a private resolver to expand the paths of
+		// add_subdirectory() and include(); runs on a pool thread.
+		static void Discover(const ListFile& file, std::vector<Pending>& out) {
+			if (!file.ok || !file.error.empty())
+				return;
+
+			VariableResolver vars;
+			Vars visible = file.inherited;
+			visible.emplace_back("CMAKE_CURRENT_LIST_DIR", platform::WideToUtf8(file.dir));
+			for (auto& [name, value] : visible)
+				vars.Set(name, value);
+
+			std::vector<std::string> values;
+			for (auto& c : file.ast.Commands()) {
+				auto args = file.ast.Args(c);
+				if (args.empty())
+					continue;
+
+				if (c.NameIs("set") && args.size() > 1) {
+					auto name = vars.Expand(args[0]);
+					vars.ExpandArgs(args, file.ast.Kinds(c), 1, values);
+					vars.Set(name, values);
+					visible.emplace_back(name, vars.Get(name));
+					continue;
+				}
+
+				bool include = c.NameIs("include");
+				if (!include && !c.NameIs("add_subdirectory"))
+					continue;
+
+				vars.ExpandArgs(args, file.ast.Kinds(c), 0, values);
+				if (values.empty())
+					continue;
+
+				Pending p;
+				p.path = ResolveListFile(include, platform::Utf8ToWide(values[0]), file.sourceDir);
+				p.sourceDir = include ? file.sourceDir : DirOf(p.path);
+				p.vars = visible;
+				if (!include)
+					p.vars.emplace_back("CMAKE_CURRENT_SOURCE_DIR", platform::WideToUtf8(p.sourceDir));
+				out.push_back(std::move(p));
+			}
+		}
+	};
+}
\ No newline at end of file
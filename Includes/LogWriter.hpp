@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MpscQueue.hpp"
+#include "Platform.hpp"
+#include "HeaderHelpers.h"
+
+namespace cmakeparser {
+
+	struct LogLine {
+		std::wstring text;     // shown on the console
+		std::wstring fullText; // goes to the log file and the callback
+		bool success = true;
+		bool repeat = false;
+	};
+
+	// Console and log-file output of a build. Any thread posts entries to an
+	// MPSC ring and returns; one writer thread drains whatever has queued up and
+	// prints it with one console write and one log-file append per batch. An
+	// entry holding several lines is never split by lines from other threads.
+	class LogWriter
+	{
+	public:
+		using Callback = std::function<void(const wchar_t*, const wchar_t*, bool, bool)>;
+
+		static constexpr size_t kRingSize = 1024;
+		static constexpr size_t kMaxBatch = 256;
+
+		explicit LogWriter(Callback callback) : callback_(std::move(callback)), ring_(kRingSize) {
+			thread_ = std::thread([this] { Loop(); });
+		}
+
+		~LogWriter() {
+			ring_.Close();
+			thread_.join();
+		}
+
+		LogWriter(const LogWriter&) = delete;
+		LogWriter& operator=(const LogWriter&) = delete;
+
+		// Entries written from now on are also appended to file (if valid).
+		void SetFile(platform::FileHandle file) { file_.store(file); }
+
+		void Post(LogLine line) {
+			std::vector<LogLine> entry;
+			entry.push_back(std::move(line));
+			Post(std::move(entry));
+		}
+
+		void Post(std::vector<LogLine> entry) {
+			posted_.fetch_add(1, std::memory_order_relaxed);
+			ring_.Push(std::move(entry));
+		}
+
+		// Waits until everything posted before the call has been written.
+		void Flush() {
+			size_t target = posted_.load(std::memory_order_relaxed);
+			for (;;) {
+				size_t done = written_.load(std::memory_order_acquire);
+				if (done >= target)
+					return;
+				written_.wait(done, std::memory_order_acquire);
+			}
+		}
+
+	private:
+		Callback callback_;
+		MpscQueue<std::vector<LogLine>> ring_;
+		std::atomic<platform::FileHandle> file_{ platform::kInvalidFileHandle };
+		std::atomic<size_t> posted_{ 0 };
+		std::atomic<size_t> written_{ 0 };
+		std::thread thread_;
+
+		void Loop() {
+			std::vector<LogLine> entry;
+			std::wstring console;
+			std::string log;
+			while (ring_.Pop(entry)) {
+				size_t count = 0;
+				do {
+					Format(entry, console, log);
+					count++;
+				} while (count < kMaxBatch && ring_.TryPop(entry));
+
+				if (!console.empty()) {
+					std::wcout << console;
+					std::wcout.flush();
+					console.clear();
+				}
+				if (!log.empty()) {
+					platform::AppendToFile(file_.load(), log.data(), log.size());
+					log.clear();
+				}
+				written_.fetch_add(count, std::memory_order_release);
+				written_.notify_all();
+			}
+		}
+
+		void Format(const std::vector<LogLine>& entry, std::wstring& console, std::string& log) {
+			bool toFile = file_.load() != platform::kInvalidFileHandle;
+			for (auto& line : entry) {
+				if (callback_ == nullptr) {
+					console += line.text;
+					console += L'\n';
+				}
+				else {
+					callback_(line.text.c_str(), line.fullText.c_str(), line.success, line.repeat);
+				}
+				if (toFile) {
+					log += stringHelper::ToStringBestEffort(line.fullText.c_str());
+					log += '\n';
+				}
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "Platform.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace cmakeparser {
+
+	// Read-only view of a whole file. Views handed out stay valid until Close().
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::wstring& path) {
+			Close();
+#ifdef _WIN32
+			file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file_ == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER size{};
+			if (!GetFileSizeEx(file_, &size)) {
+				Close();
+				return false;
+			}
+			size_ = (size_t)size.QuadPart;
+			if (size_ == 0)
+				return true;
+
+			mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping_ == nullptr) {
+				Close();
+				return false;
+			}
+			data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+			int fd = open(platform::WideToUtf8(path).c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				return false;
+
+			struct stat st{};
+			if (fstat(fd, &st) != 0) {
+				close(fd);
+				return false;
+			}
+			size_ = (size_t)st.st_size;
+			if (size_ == 0) {
+				close(fd);
+				return true;
+			}
+
+			void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			data_ = p == MAP_FAILED ? nullptr : static_cast<const char*>(p);
+#endif
+			if (data_ == nullptr) {
+				Close();
+				return false;
+			}
+			return true;
+		}
+
+		void Close() {
+#ifdef _WIN32
+			if (data_ != nullptr)
+				UnmapViewOfFile(data_);
+			if (mapping_ != nullptr)
+				CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE)
+				CloseHandle(file_);
+			mapping_ = nullptr;
+			file_ = INVALID_HANDLE_VALUE;
+#else
+			if (data_ != nullptr)
+				munmap(const_cast<char*>(data_), size_);
+#endif
+			data_ = nullptr;
+			size_ = 0;
+		}
+
+		std::string_view View() const {
+			return data_ == nullptr ? std::string_view() : std::string_view(data_, size_);
+		}
+
+		size_t Size() const { return size_; }
+
+	private:
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+#ifdef _WIN32
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+#endif
+	};
+}
\ No newline at end of file
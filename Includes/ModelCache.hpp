@@ -0,0 +1,160 @@
+#pragma once
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BuildLog.hpp"
+#include "ByteStream.hpp"
+#include "Hash.hpp"
+#include "ListFileTree.hpp"
+#include "MappedFile.hpp"
+#include "Platform.hpp"
+#include "ProjectModel.hpp"
+
+namespace cmakeparser {
+
+	// Finished ProjectModel of a previous run, stored in the user's cache
+	// directory (%LOCALAPPDATA%, $XDG_CACHE_HOME or ~/.cache, under
+	// cmakeparser/) as model-<hash of the root list file path>, so the source
+	// tree stays clean. It is valid while every list file that was read (and
+	// every optional one that was missing) is unchanged and the $ENV{} values
+	// the model used are the same. A file whose size and mtime match is taken
+	// as unchanged; otherwise its content hash decides.
+	class ModelCache
+	{
+	public:
+		static constexpr uint32_t kMagic = 0x434D5043; // "CPMC"
+		static constexpr uint32_t kVersion = 3;
+
+		explicit ModelCache(const std::wstring& rootPath) : rootPath_(rootPath) {
+			path_ = (CacheDir() / (L"model-" + ToHex(HashString(ListFileTree::Key(rootPath))))).wstring();
+		}
+
+		bool Load(ProjectModel& model, std::wstring& basePath) {
+			MappedFile file;
+			if (!file.Open(path_))
+				return false;
+
+			ByteReader r(file.View());
+			uint32_t magic = 0, version = 0, charSize = 0, inputs = 0;
+			std::wstring root;
+			if (!r.Get(magic) || !r.Get(version) || !r.Get(charSize) || magic != kMagic || version != kVersion || charSize != sizeof(wchar_t))
+				return false;
+			if (!r.GetString(root) || root != ListFileTree::Key(rootPath_) || !r.Get(inputs))
+				return false;
+
+			inputs_.clear();
+			for (uint32_t i = 0; i < inputs; ++i) {
+				Input in;
+				if (!r.GetString(in.path) || !r.Get(in.exists) || !r.Get(in.size) || !r.Get(in.mtime) || !r.Get(in.hash))
+					return false;
+				if (!IsUnchanged(in))
+					return false;
+				inputs_.push_back(std::move(in.path));
+			}
+
+			uint32_t envCount = 0;
+			if (!r.Get(envCount))
+				return false;
+			for (uint32_t i = 0; i < envCount; ++i) {
+				std::string name, value;
+				if (!r.GetString(name) || !r.GetString(value) || platform::GetEnvUtf8(name) != value)
+					return false;
+			}
+
+			std::wstring base;
+			if (!r.GetString(base) || !model.Read(r) || !r.AtEnd()) {
+				model = ProjectModel();
+				return false;
+			}
+			basePath = std::move(base);
+			return true;
+		}
+
+		bool Save(const ListFileTree& tree, const std::vector<std::string>& envReads, const ProjectModel& model, const std::wstring& basePath) {
+			ByteWriter w;
+			w.Put(kMagic);
+			w.Put(kVersion);
+			w.Put((uint32_t)sizeof(wchar_t));
+			w.PutString(std::wstring_view(ListFileTree::Key(rootPath_)));
+			w.Put((uint32_t)tree.Files().size());
+			for (auto& file : tree.Files()) {
+				uint8_t exists = file.ok ? 1 : 0;
+				w.PutString(std::wstring_view(file.path));
+				w.Put(exists);
+				w.Put((uint64_t)(exists ? file.file.Size() : 0));
+				w.Put(exists ? file.mtime : (int64_t)0);
+				w.Put(exists ? HashString(file.file.View()) : (uint64_t)0);
+			}
+			w.Put((uint32_t)envReads.size());
+			for (auto& name : envReads) {
+				w.PutString(std::string_view(name));
+				auto value = platform::GetEnvUtf8(name);
+				w.PutString(std::string_view(value));
+			}
+			w.PutString(std::wstring_view(basePath));
+			model.Write(w);
+
+			std::error_code ec;
+			std::filesystem::create_directories(std::filesystem::path(path_).parent_path(), ec);
+			if (!platform::ReplaceFile(path_, w.Data().data(), w.Data().size())) {
+				std::wcerr << L"Cannot create file: " << path_ << L"\n";
+				return false;
+			}
+			return true;
+		}
+
+		const std::wstring& Path() const { return path_; }
+		// List files recorded by the last successful Load().
+		const std::vector<std::wstring>& Inputs() const { return inputs_; }
+
+	private:
+		static std::filesystem::path CacheDir() {
+#ifdef _WIN32
+			auto base = platform::GetEnvUtf8("LOCALAPPDATA");
+#else
+			auto base = platform::GetEnvUtf8("XDG_CACHE_HOME");
+			if (base.empty()) {
+				auto home = platform::GetEnvUtf8("HOME");
+				if (!home.empty())
+					base = home + "/.cache";
+			}
+#endif
+			std::error_code ec;
+			std::filesystem::path dir = base.empty() ? std::filesystem::temp_directory_path(ec) : std::filesystem::path(platform::Utf8ToWide(base));
+			return dir / L"cmakeparser";
+		}
+
+		struct Input {
+			std::wstring path;
+			uint8_t exists = 0;
+			uint64_t size = 0;
+			int64_t mtime = 0;
+			uint64_t hash = 0;
+		};
+
+		std::wstring rootPath_;
+		std::wstring path_;
+		std::vector<std::wstring> inputs_;
+
+		static bool IsUnchanged(const Input& in) {
+			std::error_code ec;
+			bool exists = std::filesystem::exists(in.path, ec);
+			if (exists != (in.exists != 0))
+				return false;
+			if (!exists)
+				return true;
+
+			auto size = std::filesystem::file_size(in.path, ec);
+			if (ec || size != in.size)
+				return false;
+			if (BuildLog::FileTime(in.path) == in.mtime)
+				return true;
+
+			MappedFile file;
+			return file.Open(in.path) && HashString(file.View()) == in.hash;
+		}
+	};
+}
\ No newline at end of file
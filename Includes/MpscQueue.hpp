@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace cmakeparser {
+
+	// Bounded multi-producer/single-consumer ring (Vyukov's sequenced cells).
+	// A producer claims a cell with one CAS on the tail and publishes it through
+	// the cell's sequence number, so producers never take a lock and never wait
+	// for each other except when the ring is full. Empty and full rings sleep on
+	// an atomic wait like SpscQueue. After Close() the consumer drains what is
+	// left and Pop() returns false.
+	template<class T>
+	class MpscQueue
+	{
+	public:
+		explicit MpscQueue(size_t capacity) {
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+			cells_.reset(new Cell[size]);
+			mask_ = size - 1;
+			for (size_t i = 0; i < size; ++i)
+				cells_[i].seq.store(i, std::memory_order_relaxed);
+		}
+
+		MpscQueue(const MpscQueue&) = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+
+		// Any thread; waits while the ring is full.
+		void Push(T value) {
+			size_t pos = tail_.load(std::memory_order_relaxed);
+			Cell* cell;
+			for (;;) {
+				uint32_t seen = space_.load(std::memory_order_acquire);
+				cell = &cells_[pos & mask_];
+				size_t seq = cell->seq.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+				if (diff == 0) {
+					if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0) {
+					space_.wait(seen, std::memory_order_acquire);
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+				else {
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+			}
+			cell->value = std::move(value);
+			cell->seq.store(pos + 1, std::memory_order_release);
+			Signal();
+		}
+
+		// No more values follow; call once every producer is done.
+		void Close() {
+			closed_.store(true, std::memory_order_release);
+			Signal();
+		}
+
+		// Consumer side; waits for a value. False when the queue is closed and empty.
+		bool Pop(T& out) {
+			for (;;) {
+				uint32_t seen = events_.load(std::memory_order_acquire);
+				if (TryPop(out))
+					return true;
+				if (closed_.load(std::memory_order_acquire))
+					return TryPop(out);
+				events_.wait(seen, std::memory_order_acquire);
+			}
+		}
+
+		// Consumer side; false when no published value is waiting.
+		bool TryPop(T& out) {
+			Cell& cell = cells_[head_ & mask_];
+			if (cell.seq.load(std::memory_order_acquire) != head_ + 1)
+				return false;
+			out = std::move(cell.value);
+			cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+			head_++;
+			space_.fetch_add(1, std::memory_order_release);
+			space_.notify_all();
+			return true;
+		}
+
+	private:
+		struct Cell {
+			std::atomic<size_t> seq;
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> cells_;
+		size_t mask_ = 0;
+		// Owned by the consumer.
+		size_t head_ = 0;
+		alignas(64) std::atomic<size_t> tail_{ 0 };
+		// Bumped on every publish and Close(), and on every pop, so each side
+		// sleeps on a single word.
+		alignas(64) std::atomic<uint32_t> events_{ 0 };
+		alignas(64) std::atomic<uint32_t> space_{ 0 };
+		std::atomic<bool> closed_{ false };
+
+		void Signal() {
+			events_.fetch_add(1, std::memory_order_release);
+			events_.notify_one();
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BuildLog.hpp"
+#include "ByteStream.hpp"
+#include "CommandGenerator.hpp"
+#include "DependencyTracker.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "Platform.hpp"
+
+namespace cmakeparser {
+
+	// Local content-addressed store of compiled objects, in the spirit of
+	// ccache's direct mode. A manifest is keyed by the compile command, the rsp
+	// content and the compiler identity; each of its entries lists the content
+	// hashes of every file the depfile named (the source and its headers) and
+	// the result those inputs produced. Results are stored as
+	// objects/<key>.obj and .obj.d and are hardlinked (or copied) in and out of
+	// Build/obj. The mtime of a cached file is its last use; Trim() drops the
+	// least recently used files once the cache grows past its size limit.
+	//
+	// Like ccache's "file too new" check, a compile is not stored when any of
+	// its inputs changed after the compiler was started: the object may have
+	// been built from content that no longer matches the hashes.
+	class ObjectCache
+	{
+	public:
+		static constexpr uint32_t kMagic = 0x434F5043; // "CPOC"
+		static constexpr uint32_t kVersion = 1;
+		static constexpr size_t kMaxManifestEntries = 16;
+		// File-system timestamps can trail the clock (coarse kernel clocks,
+		// 2 s FAT times), so inputs this close to the start count as too new.
+		static constexpr auto kTooNewSlack = std::chrono::seconds(2);
+
+		ObjectCache(const std::wstring& dir, size_t maxMb) : dir_(dir), maxBytes_((uintmax_t)maxMb * 1024 * 1024) {
+			if (dir_.empty())
+				return;
+			std::error_code ec;
+			std::filesystem::create_directories(dir_ / L"manifests", ec);
+			std::filesystem::create_directories(dir_ / L"objects", ec);
+		}
+
+		bool Enabled() const { return !dir_.empty(); }
+
+		// Puts the cached object and depfile for the job in place; false on a miss.
+		bool Fetch(const CompileJob& job, uint64_t toolHash) {
+			if (!Enabled())
+				return false;
+
+			auto manifest = ManifestPath(job, toolHash);
+			std::vector<Entry> entries;
+			if (!ReadManifest(manifest, entries))
+				return false;
+
+			for (auto& entry : entries) {
+				bool match = std::all_of(entry.inputs.begin(), entry.inputs.end(), [this](const Input& in) {
+					return FileHash(in.path) == in.hash;
+				});
+				if (!match)
+					continue;
+
+				auto obj = ObjectPath(entry.result);
+				if (!Place(obj, job.obj) || !Place(obj + L".d", job.depFile))
+					break;
+				// Marks the entry as recently used and the object as newer than its inputs.
+				Touch(job.obj);
+				Touch(obj);
+				Touch(manifest);
+				return true;
+			}
+			return false;
+		}
+
+		// Records a fresh compile under the inputs its depfile names. started
+		// is BuildLog::FileTimeNow() taken before the compiler was dispatched.
+		void Store(const CompileJob& job, uint64_t toolHash, int64_t started) {
+			if (!Enabled())
+				return;
+
+			std::vector<std::filesystem::path> deps;
+			if (!DependencyTracker::ParseDepFile(job.depFile, deps) || deps.empty())
+				return;
+
+			auto manifest = ManifestPath(job, toolHash);
+			Entry entry;
+			entry.result = HashString(manifest.wstring());
+			auto tooNew = started - (int64_t)std::chrono::duration_cast<std::filesystem::file_time_type::duration>(kTooNewSlack).count();
+			for (auto& dep : deps) {
+				Input in{ dep.wstring(), FileHash(dep.wstring()) };
+				// Checked after hashing, so an edit while hashing is caught too.
+				if (in.hash == 0 || BuildLog::FileTime(in.path) >= tooNew)
+					return;
+				entry.result = HashCombine(entry.result, in.hash);
+				entry.inputs.push_back(std::move(in));
+			}
+
+			auto obj = ObjectPath(entry.result);
+			if (!Place(job.obj, obj) || !Place(job.depFile, obj + L".d"))
+				return;
+
+			std::vector<Entry> entries;
+			if (!ReadManifest(manifest, entries))
+				entries.clear();
+			entries.erase(std::remove_if(entries.begin(), entries.end(), [&entry](const Entry& e) { return e.result == entry.result; }), entries.end());
+			entries.insert(entries.begin(), std::move(entry));
+			if (entries.size() > kMaxManifestEntries)
+				entries.resize(kMaxManifestEntries);
+			WriteManifest(manifest, entries);
+
+			std::lock_guard<std::mutex> lk(mutex_);
+			stored_ = true;
+		}
+
+		// Deletes the least recently used files until the cache is back under
+		// 90% of its limit. Only scans when this build stored something.
+		void Trim() {
+			if (!Enabled() || !stored_ || maxBytes_ == 0)
+				return;
+
+			struct File {
+				std::filesystem::file_time_type time;
+				uintmax_t size;
+				std::filesystem::path path;
+			};
+			std::vector<File> files;
+			uintmax_t total = 0;
+			std::error_code ec;
+			for (auto& entry : std::filesystem::recursive_directory_iterator(dir_, ec)) {
+				if (!entry.is_regular_file(ec))
+					continue;
+				File f{ entry.last_write_time(ec), entry.file_size(ec), entry.path() };
+				total += f.size;
+				files.push_back(std::move(f));
+			}
+			if (total <= maxBytes_)
+				return;
+
+			std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.time < b.time; });
+			uintmax_t target = maxBytes_ / 10 * 9;
+			for (auto& f : files) {
+				if (total <= target)
+					break;
+				if (std::filesystem::remove(f.path, ec))
+					total -= f.size;
+			}
+		}
+
+	private:
+		struct Input {
+			std::wstring path;
+			uint64_t hash;
+		};
+
+		struct Entry {
+			uint64_t result = 0;
+			std::vector<Input> inputs;
+		};
+
+		std::filesystem::path dir_;
+		uintmax_t maxBytes_;
+		bool stored_ = false;
+		std::mutex mutex_;
+		struct Hashed {
+			int64_t mtime;
+			uint64_t hash;
+		};
+		// Content hashes taken during this build, reused while the mtime is
+		// the same; headers are shared by many jobs.
+		std::unordered_map<std::wstring, Hashed> hashes_;
+
+		std::filesystem::path ManifestPath(const CompileJob& job, uint64_t toolHash) const {
+			uint64_t key = HashCombine(HashCombine(job.commandHash, job.rspHash), toolHash);
+			return dir_ / L"manifests" / (ToHex(key) + L".m");
+		}
+
+		std::wstring ObjectPath(uint64_t result) const {
+			return (dir_ / L"objects" / (ToHex(result) + L".obj")).wstring();
+		}
+
+		// 0 when the file cannot be read.
+		uint64_t FileHash(const std::wstring& path) {
+			int64_t mtime = BuildLog::FileTime(path);
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				auto it = hashes_.find(path);
+				if (it != hashes_.end() && it->second.mtime == mtime)
+					return it->second.hash;
+			}
+
+			MappedFile file;
+			uint64_t hash = file.Open(path) ? HashCombine(HashString(file.View()), file.Size()) : 0;
+			if (hash == 0)
+				return 0;
+			std::lock_guard<std::mutex> lk(mutex_);
+			hashes_[path] = { mtime, hash };
+			return hash;
+		}
+
+		bool ReadManifest(const std::filesystem::path& path, std::vector<Entry>& entries) const {
+			MappedFile file;
+			if (!file.Open(path.wstring()))
+				return false;
+
+			ByteReader r(file.View());
+			uint32_t magic = 0, version = 0, count = 0;
+			if (!r.Get(magic) || !r.Get(version) || !r.Get(count) || magic != kMagic || version != kVersion)
+				return false;
+			for (uint32_t i = 0; i < count; ++i) {
+				Entry e;
+				uint32_t inputs = 0;
+				if (!r.Get(e.result) || !r.Get(inputs))
+					return false;
+				for (uint32_t k = 0; k < inputs; ++k) {
+					Input in;
+					if (!r.GetString(in.path) || !r.Get(in.hash))
+						return false;
+					e.inputs.push_back(std::move(in));
+				}
+				entries.push_back(std::move(e));
+			}
+			return r.AtEnd();
+		}
+
+		void WriteManifest(const std::filesystem::path& path, const std::vector<Entry>& entries) const {
+			ByteWriter w;
+			w.Put(kMagic);
+			w.Put(kVersion);
+			w.Put((uint32_t)entries.size());
+			for (auto& e : entries) {
+				w.Put(e.result);
+				w.Put((uint32_t)e.inputs.size());
+				for (auto& in : e.inputs) {
+					w.PutString(std::wstring_view(in.path));
+					w.Put(in.hash);
+				}
+			}
+
+			if (!platform::ReplaceFile(path.wstring(), w.Data().data(), w.Data().size()))
+				std::wcerr << L"Cannot create file: " << path.wstring() << L"\n";
+		}
+
+		// Hardlinks from to to, copying when the two are on different volumes.
+		static bool Place(const std::wstring& from, const std::wstring& to) {
+			std::error_code ec;
+			std::filesystem::remove(to, ec);
+			std::filesystem::create_hard_link(from, to, ec);
+			if (!ec)
+				return true;
+			ec.clear();
+			return std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, ec) && !ec;
+		}
+
+		static void Touch(const std::filesystem::path& path) {
+			std::error_code ec;
+			std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <clocale>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cmakeparser::platform {
+
+#ifdef _WIN32
+	using FileHandle = HANDLE;
+	inline const FileHandle kInvalidFileHandle = INVALID_HANDLE_VALUE;
+	constexpr const wchar_t* kExeSuffix = L".exe";
+	// Compiler response files and command lines use the ANSI code page.
+	constexpr unsigned kNativeCodePage = 1251;
+#else
+	using FileHandle = int;
+	constexpr FileHandle kInvalidFileHandle = -1;
+	constexpr const wchar_t* kExeSuffix = L"";
+#endif
+
+	inline std::wstring Utf8ToWide(std::string_view s) {
+		if (s.empty()) return {};
+#ifdef _WIN32
+		int size = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0);
+		std::wstring out(size, 0);
+		MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), out.data(), size);
+		return out;
+#else
+		std::wstring out;
+		out.reserve(s.size());
+		size_t i = 0;
+		while (i < s.size()) {
+			unsigned char c = (unsigned char)s[i];
+			char32_t cp;
+			size_t len;
+			if (c < 0x80) { cp = c; len = 1; }
+			else if ((c & 0xE0) == 0xC0) { cp = c & 0x1F; len = 2; }
+			else if ((c & 0xF0) == 0xE0) { cp = c & 0x0F; len = 3; }
+			else if ((c & 0xF8) == 0xF0) { cp = c & 0x07; len = 4; }
+			else { out += L'\xFFFD'; i++; continue; }
+
+			if (i + len > s.size()) { out += L'\xFFFD'; break; }
+			bool valid = true;
+			for (size_t k = 1; k < len; ++k) {
+				unsigned char cc = (unsigned char)s[i + k];
+				if ((cc & 0xC0) != 0x80) { valid = false; break; }
+				cp = (cp << 6) | (cc & 0x3F);
+			}
+			if (!valid) { out += L'\xFFFD'; i++; continue; }
+			out += (wchar_t)cp;
+			i += len;
+		}
+		return out;
+#endif
+	}
+
+	inline std::string WideToUtf8(std::wstring_view w) {
+		if (w.empty()) return {};
+#ifdef _WIN32
+		int size = WideCharToMultiByte(CP_UTF8, 0, w.data(), (int)w.size(), nullptr, 0, nullptr, nullptr);
+		std::string out(size, 0);
+		WideCharToMultiByte(CP_UTF8, 0, w.data(), (int)w.size(), out.data(), size, nullptr, nullptr);
+		return out;
+#else
+		std::string out;
+		out.reserve(w.size());
+		for (wchar_t wc : w) {
+			char32_t cp = (char32_t)wc;
+			if (cp < 0x80) {
+				out += (char)cp;
+			}
+			else if (cp < 0x800) {
+				out += (char)(0xC0 | (cp >> 6));
+				out += (char)(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000) {
+				out += (char)(0xE0 | (cp >> 12));
+				out += (char)(0x80 | ((cp >> 6) & 0x3F));
+				out += (char)(0x80 | (cp & 0x3F));
+			}
+			else {
+				out += (char)(0xF0 | (cp >> 18));
+				out += (char)(0x80 | ((cp >> 12) & 0x3F));
+				out += (char)(0x80 | ((cp >> 6) & 0x3F));
+				out += (char)(0x80 | (cp & 0x3F));
+			}
+		}
+		return out;
+#endif
+	}
+
+	// Encoding the toolchain expects in rsp files: CP1251 on Windows, UTF-8 elsewhere.
+	inline std::string WideToNative(std::wstring_view w) {
+#ifdef _WIN32
+		if (w.empty()) return {};
+		int size = WideCharToMultiByte(kNativeCodePage, 0, w.data(), (int)w.size(), NULL, 0, NULL, NULL);
+		std::string out(size, 0);
+		WideCharToMultiByte(kNativeCodePage, 0, w.data(), (int)w.size(), &out[0], size, NULL, NULL);
+		return out;
+#else
+		return WideToUtf8(w);
+#endif
+	}
+
+	// UTF-8 value of an environment variable; empty when it is not set.
+	inline std::string GetEnvUtf8(std::string_view name) {
+#ifdef _WIN32
+		const wchar_t* v = _wgetenv(Utf8ToWide(name).c_str());
+		return v == nullptr ? std::string() : WideToUtf8(v);
+#else
+		const char* v = std::getenv(std::string(name).c_str());
+		return v == nullptr ? std::string() : std::string(v);
+#endif
+	}
+
+	inline bool AppendToFile(FileHandle handle, const char* data, size_t size) {
+		if (handle == kInvalidFileHandle)
+			return false;
+#ifdef _WIN32
+		LARGE_INTEGER zero{};
+		if (!SetFilePointerEx(handle, zero, nullptr, FILE_END))
+			return false;
+		DWORD written = 0;
+		return WriteFile(handle, data, static_cast<DWORD>(size), &written, nullptr) && written == size;
+#else
+		while (size > 0) {
+			auto n = ::write(handle, data, size);
+			if (n <= 0)
+				return false;
+			data += n;
+			size -= (size_t)n;
+		}
+		return true;
+#endif
+	}
+
+	// Replaces the file with data in one write call (a short write is resumed).
+	inline bool WriteWholeFile(const std::wstring& path, const char* data, size_t size) {
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		DWORD written = 0;
+		bool ok = WriteFile(file, data, static_cast<DWORD>(size), &written, nullptr) && written == size;
+		CloseHandle(file);
+		return ok;
+#else
+		int fd = ::open(WideToUtf8(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return false;
+		bool ok = true;
+		while (size > 0) {
+			auto n = ::write(fd, data, size);
+			if (n <= 0) {
+				ok = false;
+				break;
+			}
+			data += n;
+			size -= (size_t)n;
+		}
+		return ::close(fd) == 0 && ok;
+#endif
+	}
+
+	// A name next to path that no other process writes to, so builds sharing
+	// a directory (a --cache-dir, say) never write the same temporary file.
+	inline std::wstring TempPathFor(const std::wstring& path) {
+#ifdef _WIN32
+		unsigned long pid = GetCurrentProcessId();
+#else
+		unsigned long pid = (unsigned long)getpid();
+#endif
+		return path + L"." + std::to_wstring(pid) + L".tmp";
+	}
+
+	// Moves from over to in one step; readers see the old file or the new one.
+	// A failed move removes from.
+	inline bool ReplaceWith(const std::wstring& from, const std::wstring& to) {
+#ifdef _WIN32
+		if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING))
+			return true;
+		DeleteFileW(from.c_str());
+#else
+		if (::rename(WideToUtf8(from).c_str(), WideToUtf8(to).c_str()) == 0)
+			return true;
+		::unlink(WideToUtf8(from).c_str());
+#endif
+		return false;
+	}
+
+	// Replaces the file with data without a moment where it is partly written:
+	// the data goes to TempPathFor(path), which is then moved over path.
+	inline bool ReplaceFile(const std::wstring& path, const char* data, size_t size) {
+		auto tmp = TempPathFor(path);
+		if (WriteWholeFile(tmp, data, size))
+			return ReplaceWith(tmp, path);
+#ifdef _WIN32
+		DeleteFileW(tmp.c_str());
+#else
+		::unlink(WideToUtf8(tmp).c_str());
+#endif
+		return false;
+	}
+
+	// Switches the console to wide output until Restore().
+	class ConsoleMode
+	{
+	public:
+		ConsoleMode() {
+#ifdef _WIN32
+			oldMode_ = _setmode(_fileno(stdout), _O_U16TEXT);
+#else
+			std::setlocale(LC_ALL, "");
+#endif
+		}
+
+		void Restore() {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), oldMode_);
+#endif
+		}
+
+	private:
+		int oldMode_ = 0;
+	};
+
+	// Leaves without running static destructors (the thread pool is not joined).
+	[[noreturn]] inline void ExitProcessNow(int code) {
+		std::fflush(stdout);
+#ifdef _WIN32
+		TerminateProcess(GetCurrentProcess(), (UINT)code);
+#endif
+		std::_Exit(code);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "ProcessRunner.hpp"
+
+#ifdef _WIN32
+#include "Task.h"
+#else
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#endif
+
+namespace cmakeparser {
+
+	struct ProcessStats {
+		std::chrono::steady_clock::time_point started;
+		uint32_t durationMs = 0;
+		uint32_t peakRssMb = 0;
+	};
+
+	// Owns every running child. On POSIX a single thread multiplexes all child
+	// pipes through epoll and reaps exits, so no pool thread waits on a compiler
+	// and the number of children does not depend on the pool size. Windows keeps
+	// one pool task per child on top of ProcessRunGuard.
+	class ProcessReactor
+	{
+	public:
+		using ExitCallback = std::function<void(ProcessRunGuardResult&, const ProcessStats&)>;
+
+		ProcessReactor() {
+#ifndef _WIN32
+			epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+			wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			epoll_event ev{};
+			ev.events = EPOLLIN;
+			ev.data.ptr = nullptr;
+			epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+			thread_ = std::thread([this] { Loop(); });
+#endif
+		}
+
+		~ProcessReactor() {
+			WaitIdle();
+#ifndef _WIN32
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				stopping_ = true;
+			}
+			Wake();
+			thread_.join();
+			close(wakeFd_);
+			close(epollFd_);
+#endif
+		}
+
+		ProcessReactor(const ProcessReactor&) = delete;
+		ProcessReactor& operator=(const ProcessReactor&) = delete;
+
+		// onExit runs on the reactor thread (a pool thread on Windows) and should be short.
+		void Submit(const std::wstring& command, ExitCallback onExit) {
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				active_++;
+#ifndef _WIN32
+				queue_.push_back({ command, std::move(onExit) });
+#endif
+			}
+#ifdef _WIN32
+			Task<void> task([this, command, onExit] {
+				auto started = std::chrono::steady_clock::now();
+				ProcessRunGuardResult result;
+				guard_.RunCommand(command, result);
+				ProcessStats stats;
+				stats.started = started;
+				stats.durationMs = ElapsedMs(started);
+				onExit(result, stats);
+				Finish();
+				});
+			task.Start(TaskPriority::Normal, TaskBound::IOBound);
+#else
+			Wake();
+#endif
+		}
+
+		void WaitIdle() {
+			std::unique_lock<std::mutex> lk(mutex_);
+			idleCv_.wait(lk, [this] { return active_ == 0; });
+		}
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable idleCv_;
+		size_t active_ = 0;
+
+		static uint32_t ElapsedMs(std::chrono::steady_clock::time_point started) {
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+			return ms <= 0 ? 1 : (uint32_t)ms;
+		}
+
+		void Finish() {
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				active_--;
+			}
+			idleCv_.notify_all();
+		}
+
+#ifdef _WIN32
+		ProcessRunGuard guard_;
+#else
+		struct Child;
+
+		struct Stream {
+			Child* owner = nullptr;
+			int fd = -1;
+			std::string data;
+		};
+
+		struct Child {
+			std::wstring command;
+			ExitCallback onExit;
+			pid_t pid = -1;
+			Stream out;
+			Stream err;
+			int openStreams = 2;
+			std::chrono::steady_clock::time_point started;
+		};
+
+		struct Pending {
+			std::wstring command;
+			ExitCallback onExit;
+		};
+
+		static constexpr int kReapPollMs = 5;
+
+		int epollFd_ = -1;
+		int wakeFd_ = -1;
+		bool stopping_ = false;
+		std::thread thread_;
+		std::deque<Pending> queue_;
+		std::vector<std::unique_ptr<Child>> running_;
+		std::vector<Child*> reaping_;
+
+		void Wake() {
+			uint64_t one = 1;
+			auto n = write(wakeFd_, &one, sizeof(one));
+			(void)n;
+		}
+
+		void Loop() {
+			epoll_event events[64];
+			while (true) {
+				int timeout = reaping_.empty() ? -1 : kReapPollMs;
+				int n = epoll_wait(epollFd_, events, 64, timeout);
+				if (n < 0 && errno != EINTR)
+					break;
+
+				for (int i = 0; i < n; ++i) {
+					if (events[i].data.ptr == nullptr) {
+						uint64_t value;
+						while (read(wakeFd_, &value, sizeof(value)) > 0) {}
+						continue;
+					}
+					ReadStream(*static_cast<Stream*>(events[i].data.ptr));
+				}
+
+				SpawnQueued();
+				Reap();
+
+				std::lock_guard<std::mutex> lk(mutex_);
+				if (stopping_ && active_ == 0)
+					break;
+			}
+		}
+
+		void SpawnQueued() {
+			std::deque<Pending> pending;
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				pending.swap(queue_);
+			}
+
+			for (auto& p : pending) {
+				auto child = std::make_unique<Child>();
+				child->command = std::move(p.command);
+				child->onExit = std::move(p.onExit);
+				child->started = std::chrono::steady_clock::now();
+
+				if (!ProcessRunGuard::Spawn(child->command, child->pid, child->out.fd, child->err.fd)) {
+					ProcessRunGuardResult result;
+					result.command = child->command;
+					result.code = 127;
+					result.stderrText = L"Cannot start process: " + child->command + L"\n";
+					ProcessStats stats;
+					stats.started = child->started;
+					child->onExit(result, stats);
+					Finish();
+					continue;
+				}
+
+				Watch(*child, child->out);
+				Watch(*child, child->err);
+				running_.push_back(std::move(child));
+			}
+		}
+
+		void Watch(Child& child, Stream& stream) {
+			stream.owner = &child;
+			fcntl(stream.fd, F_SETFL, fcntl(stream.fd, F_GETFL) | O_NONBLOCK);
+			epoll_event ev{};
+			ev.events = EPOLLIN;
+			ev.data.ptr = &stream;
+			epoll_ctl(epollFd_, EPOLL_CTL_ADD, stream.fd, &ev);
+		}
+
+		void ReadStream(Stream& stream) {
+			char buf[16384];
+			while (true) {
+				auto n = read(stream.fd, buf, sizeof(buf));
+				if (n > 0) {
+					stream.data.append(buf, (size_t)n);
+					continue;
+				}
+				if (n < 0 && (errno == EAGAIN || errno == EINTR))
+					return;
+
+				epoll_ctl(epollFd_, EPOLL_CTL_DEL, stream.fd, nullptr);
+				close(stream.fd);
+				stream.fd = -1;
+				if (--stream.owner->openStreams == 0)
+					reaping_.push_back(stream.owner);
+				return;
+			}
+		}
+
+		// Both pipes are closed; collect the exit status without blocking the loop.
+		void Reap() {
+			for (size_t i = 0; i < reaping_.size();) {
+				Child* child = reaping_[i];
+				int status = 0;
+				rusage usage{};
+				auto rc = wait4(child->pid, &status, WNOHANG, &usage);
+				if (rc == 0 || (rc < 0 && errno == EINTR)) {
+					++i;
+					continue;
+				}
+
+				ProcessRunGuardResult result;
+				result.command = child->command;
+				result.code = rc < 0 ? -1 : ProcessRunGuard::ExitCode(status);
+				result.success = result.code == 0;
+				result.stdoutText = platform::Utf8ToWide(child->out.data);
+				result.stderrText = platform::Utf8ToWide(child->err.data);
+
+				ProcessStats stats;
+				stats.started = child->started;
+				stats.durationMs = ElapsedMs(child->started);
+				stats.peakRssMb = (uint32_t)(usage.ru_maxrss / 1024);
+				child->onExit(result, stats);
+
+				reaping_[i] = reaping_.back();
+				reaping_.pop_back();
+				for (size_t k = 0; k < running_.size(); ++k) {
+					if (running_[k].get() == child) {
+						running_[k] = std::move(running_.back());
+						running_.pop_back();
+						break;
+					}
+				}
+				Finish();
+			}
+		}
+#endif
+	};
+}
\ No newline at end of file
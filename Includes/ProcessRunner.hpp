@@ -0,0 +1,174 @@
+#pragma once
+
+// Windows uses the external ProcessRunGuard; elsewhere the same interface is
+// implemented on top of posix_spawn with the child's pipes drained via poll().
+#ifdef _WIN32
+#include "ProcessRunGuard.h"
+#else
+
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "Platform.hpp"
+
+extern char** environ;
+
+struct ProcessRunGuardResult {
+	int code = -1;
+	bool success = false;
+	std::wstring command;
+	std::wstring stdoutText;
+	std::wstring stderrText;
+};
+
+class ProcessRunGuard {
+public:
+	bool RunCommand(const std::wstring& command, ProcessRunGuardResult& result) {
+		result = {};
+		result.command = command;
+
+		pid_t pid = -1;
+		int outFd = -1;
+		int errFd = -1;
+		if (!Spawn(command, pid, outFd, errFd)) {
+			result.code = 127;
+			result.stderrText = L"Cannot start process: " + command + L"\n";
+			return false;
+		}
+
+		std::string out;
+		std::string err;
+		Drain(outFd, errFd, out, err);
+		close(outFd);
+		close(errFd);
+
+		int status = 0;
+		while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+
+		result.code = ExitCode(status);
+		result.success = result.code == 0;
+		result.stdoutText = cmakeparser::platform::Utf8ToWide(out);
+		result.stderrText = cmakeparser::platform::Utf8ToWide(err);
+		return result.success;
+	}
+
+	// Starts the command with stdout/stderr redirected into pipes; the caller
+	// owns the returned read ends and has to reap pid.
+	static bool Spawn(const std::wstring& command, pid_t& pid, int& outFd, int& errFd) {
+		std::vector<std::string> args = SplitCommandLine(cmakeparser::platform::WideToUtf8(command));
+		if (args.empty())
+			return false;
+
+		int outPipe[2];
+		int errPipe[2];
+		if (pipe2(outPipe, O_CLOEXEC) != 0)
+			return false;
+		if (pipe2(errPipe, O_CLOEXEC) != 0) {
+			close(outPipe[0]);
+			close(outPipe[1]);
+			return false;
+		}
+
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+		posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+		std::vector<char*> argv;
+		argv.reserve(args.size() + 1);
+		for (auto& a : args)
+			argv.push_back(a.data());
+		argv.push_back(nullptr);
+
+		int rc = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+		posix_spawn_file_actions_destroy(&actions);
+		close(outPipe[1]);
+		close(errPipe[1]);
+
+		if (rc != 0) {
+			close(outPipe[0]);
+			close(errPipe[0]);
+			return false;
+		}
+
+		outFd = outPipe[0];
+		errFd = errPipe[0];
+		return true;
+	}
+
+	static int ExitCode(int status) {
+		if (WIFEXITED(status))
+			return WEXITSTATUS(status);
+		if (WIFSIGNALED(status))
+			return 128 + WTERMSIG(status);
+		return -1;
+	}
+
+	// Reverses CommandGenerator::quote_w: blanks separate arguments, "..." groups
+	// them and \" inside quotes is a literal quote.
+	static std::vector<std::string> SplitCommandLine(const std::string& line) {
+		std::vector<std::string> out;
+		std::string cur;
+		bool quoted = false;
+		bool has = false;
+		for (size_t i = 0; i < line.size(); ++i) {
+			char c = line[i];
+			if (quoted && c == '\\' && i + 1 < line.size() && line[i + 1] == '"') {
+				cur += '"';
+				i++;
+				continue;
+			}
+			if (c == '"') {
+				quoted = !quoted;
+				has = true;
+				continue;
+			}
+			if (!quoted && (c == ' ' || c == '\t')) {
+				if (has || !cur.empty())
+					out.push_back(std::move(cur));
+				cur.clear();
+				has = false;
+				continue;
+			}
+			cur += c;
+		}
+		if (has || !cur.empty())
+			out.push_back(std::move(cur));
+		return out;
+	}
+
+private:
+	static void Drain(int outFd, int errFd, std::string& out, std::string& err) {
+		pollfd fds[2] = { { outFd, POLLIN, 0 }, { errFd, POLLIN, 0 } };
+		std::string* sinks[2] = { &out, &err };
+		int open = 2;
+		char buf[16384];
+		while (open > 0) {
+			if (poll(fds, 2, -1) < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			for (int i = 0; i < 2; ++i) {
+				if (fds[i].fd < 0 || (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+					continue;
+				auto n = read(fds[i].fd, buf, sizeof(buf));
+				if (n > 0) {
+					sinks[i]->append(buf, (size_t)n);
+				}
+				else if (n == 0 || errno != EINTR) {
+					fds[i].fd = -1;
+					open--;
+				}
+			}
+		}
+	}
+};
+
+#endif
\ No newline at end of file
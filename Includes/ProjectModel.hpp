@@ -1,37 +1,73 @@
 #pragma once
 
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ByteStream.hpp"
+#include "StringPool.hpp"
+
 namespace cmakeparser {
 
+	// Source paths are split into an interned directory prefix (with its
+	// trailing separator, possibly empty) and file name, so the shared prefixes
+	// of thousands of sources are stored once.
+	struct PathRef {
+		uint32_t dir;
+		uint32_t name;
+	};
+
+	// Values arrive with variable references already expanded. Every string is
+	// interned once and referenced by a 32-bit id; the quoted form used on
+	// command lines and in rsp files is prepared at intern time.
 	class ProjectModel {
 	public:
-		void AddIncludeDir(const std::wstring& d, const std::wstring baseDir) {
-			include_dirs_.push_back(NormalizePath(d, baseDir));
+		using Id = uint32_t;
+
+		void AddIncludeDir(const std::wstring& d) {
+			include_dirs_.push_back(Intern(d));
 		}
-		void AddSet(const std::wstring& k, const std::vector<std::wstring>& v) { sets_[k] = v; }
-		void AddTarget(const std::wstring& t, const std::vector<std::wstring>& s) { targets_[t] = s; }
-		void AddProject(const std::wstring& p, const std::wstring& baseDir) { projects_.push_back(NormalizePath(p, baseDir)); }
-		void AddSrc(const std::wstring& p, const std::wstring& baseDir) { src_.push_back(NormalizePath(p, baseDir)); }
-		void AddLink(const std::wstring& p, const std::wstring& baseDir, const std::wstring& search) { linklibraries_.push_back(NormalizePath(p, baseDir, search)); }
+		void AddSet(const std::wstring& k, const std::vector<std::wstring>& v) { sets_[Intern(k)] = InternAll(v); }
+		void AddTarget(const std::wstring& t, const std::vector<std::wstring>& s) { targets_[Intern(t)] = InternAll(s); }
+		void AddProject(const std::wstring& p) { projects_.push_back(Intern(p)); }
+		void AddSrc(const std::wstring& p) { src_.push_back(InternPath(p)); }
+		void AddLink(const std::wstring& p) { linklibraries_.push_back(Intern(p)); }
 		void AddCompileFlags(const std::wstring& f) {
 			std::wstringstream ss(f);
 			std::wstring word;
-			while (ss >> word) compile_flags_.push_back(word);
+			while (ss >> word) compile_flags_.push_back(Intern(word));
 		}
 
 		void AddAsmFlags(const std::wstring& f) {
 			std::wstringstream ss(f);
 			std::wstring word;
-			while (ss >> word) linkAsmFlag_.push_back(word);
+			while (ss >> word) linkAsmFlag_.push_back(Intern(word));
 		}
 
+		// "-T script" and "-Tscript" name the linker script; it is passed
+		// separately, everything else is a plain link flag.
 		void AddLinkFlags(const std::wstring& f) {
 			std::wstringstream ss(f);
 			std::wstring word;
-			while (ss >> word) linkFlag_.push_back(word);
+			bool script = false;
+			while (ss >> word) {
+				if (script) {
+					AddLinkTFlags(Unquote(word));
+					script = false;
+				}
+				else if (word == L"-T")
+					script = true;
+				else if (word.size() > 2 && word.compare(0, 2, L"-T") == 0)
+					AddLinkTFlags(Unquote(word.substr(2)));
+				else
+					linkFlag_.push_back(Intern(word));
+			}
 		}
 
 		void AddLinkTFlags(const std::wstring& f) {
-			linkTFlag_.push_back(f);
+			linkTFlag_.push_back(Intern(f));
 		}
 
 		const auto& IncludeDirs() const { return include_dirs_; }
@@ -44,35 +80,167 @@ namespace cmakeparser {
 		const auto& LinkTFlags() const { return linkTFlag_; }
 		const auto& LinkAsmFlags() const { return linkAsmFlag_; }
 
-		const std::wstring& GetSrcPathC(size_t index) const {
-			static const std::wstring empty;
-			if (src_.size() > index) return src_[index];
-			return empty;
+		std::wstring_view Str(Id id) const { return strings_.Get(id); }
+
+		// Appends prefix + string, wrapped in quotes when it contains blanks or
+		// quotes ("-I" + dir -> "-Ic:/my dir").
+		void AppendQuoted(std::wstring& out, std::wstring_view prefix, Id id) const {
+			if (!needsQuote_[id]) {
+				out.append(prefix).append(Str(id));
+				return;
+			}
+			out += L'"';
+			out.append(prefix).append(strings_.Get(escaped_[id]));
+			out += L'"';
+		}
+
+		void AppendPath(std::wstring& out, PathRef p) const {
+			out.append(Str(p.dir)).append(Str(p.name));
+		}
+
+		void AppendQuotedPath(std::wstring& out, PathRef p) const {
+			if (!needsQuote_[p.dir] && !needsQuote_[p.name]) {
+				AppendPath(out, p);
+				return;
+			}
+			out += L'"';
+			out.append(strings_.Get(escaped_[p.dir])).append(strings_.Get(escaped_[p.name]));
+			out += L'"';
+		}
+
+		PathRef GetSrc(size_t index) const { return src_[index]; }
+
+		std::wstring GetSrcPathC(size_t index) const {
+			std::wstring out;
+			if (src_.size() > index) AppendPath(out, src_[index]);
+			return out;
 		}
 
 		size_t SrcCount() const { return src_.size(); }
 
+		// Snapshot for the model cache. Strings are written in id order, so
+		// re-interning them on Read() yields the same ids.
+		void Write(ByteWriter& w) const {
+			w.Put((uint32_t)strings_.Size());
+			for (Id id = 0; id < strings_.Size(); ++id)
+				w.PutString(strings_.Get(id));
+			w.PutVector(needsQuote_);
+			w.PutVector(escaped_);
+			for (auto* list : { &include_dirs_, &projects_, &compile_flags_, &linklibraries_, &linkFlag_, &linkTFlag_, &linkAsmFlag_ })
+				w.PutVector(*list);
+			w.PutVector(src_);
+			for (auto* map : { &sets_, &targets_ }) {
+				w.Put((uint32_t)map->Size());
+				for (auto& [key, values] : map->Entries()) {
+					w.Put(key);
+					w.PutVector(values);
+				}
+			}
+		}
+
+		bool Read(ByteReader& r) {
+			*this = ProjectModel();
+			uint32_t count = 0;
+			if (!r.Get(count))
+				return false;
+			std::wstring s;
+			for (Id id = 0; id < count; ++id) {
+				if (!r.GetString(s) || strings_.Intern(s) != id)
+					return false;
+			}
+			if (!r.GetVector(needsQuote_) || !r.GetVector(escaped_) || needsQuote_.size() != count || escaped_.size() != count)
+				return false;
+
+			auto valid = [count](const std::vector<Id>& ids) {
+				return std::all_of(ids.begin(), ids.end(), [count](Id id) { return id < count; });
+			};
+			if (!valid(escaped_))
+				return false;
+			for (auto* list : { &include_dirs_, &projects_, &compile_flags_, &linklibraries_, &linkFlag_, &linkTFlag_, &linkAsmFlag_ }) {
+				if (!r.GetVector(*list) || !valid(*list))
+					return false;
+			}
+			if (!r.GetVector(src_))
+				return false;
+			for (auto& p : src_) {
+				if (p.dir >= count || p.name >= count)
+					return false;
+			}
+			for (auto* map : { &sets_, &targets_ }) {
+				uint32_t entries = 0;
+				if (!r.Get(entries))
+					return false;
+				for (uint32_t i = 0; i < entries; ++i) {
+					Id key = 0;
+					std::vector<Id> values;
+					if (!r.Get(key) || key >= count || !r.GetVector(values) || !valid(values))
+						return false;
+					(*map)[key] = std::move(values);
+				}
+			}
+			return true;
+		}
+
 	private:
-		std::vector<std::wstring> include_dirs_;
-		std::map<std::wstring, std::vector<std::wstring>> sets_;
-		std::map<std::wstring, std::vector<std::wstring>> targets_;
-		std::vector<std::wstring> projects_;
-		std::vector<std::wstring> compile_flags_;
-		std::vector<std::wstring> src_;
-		std::vector<std::wstring> linklibraries_;
-		std::vector<std::wstring> linkFlag_;
-		std::vector<std::wstring> linkTFlag_;
-		std::vector<std::wstring> linkAsmFlag_;
+		WStringPool strings_;
+		// Per id: whether the string needs quoting, and the id of its body with
+		// '"' escaped (the same id when there is nothing to escape).
+		std::vector<uint8_t> needsQuote_;
+		std::vector<Id> escaped_;
+
+		std::vector<Id> include_dirs_;
+		IdMap<std::vector<Id>> sets_;
+		IdMap<std::vector<Id>> targets_;
+		std::vector<Id> projects_;
+		std::vector<Id> compile_flags_;
+		std::vector<PathRef> src_;
+		std::vector<Id> linklibraries_;
+		std::vector<Id> linkFlag_;
+		std::vector<Id> linkTFlag_;
+		std::vector<Id> linkAsmFlag_;
 
 	private:
-		std::wstring NormalizePath(const std::wstring& d, const std::wstring baseDir, std::wstring search = L"${BASE_DIR}") const {
-			std::wstring result = d;
-			size_t pos = 0;
-			while ((pos = result.find(search, pos)) != std::wstring::npos) {
-				result.replace(pos, search.length(), baseDir);
-				pos += baseDir.length();
+		Id Intern(std::wstring_view s) {
+			Id id = strings_.Intern(s);
+			if (id < needsQuote_.size())
+				return id;
+
+			bool quote = s.find_first_of(L" \t\"") != std::wstring_view::npos;
+			needsQuote_.push_back(quote ? 1 : 0);
+			escaped_.push_back(id);
+			if (s.find(L'"') != std::wstring_view::npos) {
+				std::wstring body;
+				for (wchar_t c : s) {
+					if (c == L'"') body += L"\\\""; else body.push_back(c);
+				}
+				// The body is only ever used inside quotes; it is not escaped again.
+				Id bodyId = strings_.Intern(body);
+				if (bodyId == needsQuote_.size()) {
+					needsQuote_.push_back(1);
+					escaped_.push_back(bodyId);
+				}
+				escaped_[id] = bodyId;
 			}
-			return result;
+			return id;
+		}
+
+		std::vector<Id> InternAll(const std::vector<std::wstring>& v) {
+			std::vector<Id> out;
+			out.reserve(v.size());
+			for (auto& s : v) out.push_back(Intern(s));
+			return out;
+		}
+
+		PathRef InternPath(std::wstring_view p) {
+			size_t slash = p.find_last_of(L"/\\");
+			size_t split = slash == std::wstring_view::npos ? 0 : slash + 1;
+			return { Intern(p.substr(0, split)), Intern(p.substr(split)) };
+		}
+
+		static std::wstring Unquote(const std::wstring& s) {
+			if (s.size() >= 2 && (s.front() == L'"' || s.front() == L'\'') && s.back() == s.front())
+				return s.substr(1, s.size() - 2);
+			return s;
 		}
 	};
 }
\ No newline at end of file
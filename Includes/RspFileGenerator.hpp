@@ -1,7 +1,13 @@
 ﻿#pragma once
 
+#include <deque>
 #include <filesystem>
+#include <unordered_map>
 #include "ProjectModel.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "Platform.hpp"
+#include "Trace.hpp"
 
 namespace cmakeparser {
 
@@ -12,111 +18,199 @@ namespace cmakeparser {
 			
 		}
 
+		// All sources currently share the project-wide flags, so the content is
+		// encoded once and one rsp file is named per distinct content hash. The
+		// files themselves are written by Flush().
 		bool CreateNextRspFile(std::wstring& rspFile) {
-			auto fileName = std::filesystem::path(model_.GetSrcPathC(index_)).filename().wstring();
-			rspFile = rspDir_ + L"/" + fileName + L".obj_compile.rsp";
-			std::ofstream  ofs(rspFile, std::ios::out | std::ios::trunc);
-			if (!ofs) {
-				std::wcerr << L"Cannot create file: " << rspFile << L"\n";
-				return false;
+			if (!compileReady_) {
+				compileContent_ = ToAnsi(CompileFlags());
+				compileHash_ = HashString(compileContent_);
+				compileReady_ = true;
 			}
 
-			const auto& flags = model_.Flags();
-			const auto& inc = model_.IncludeDirs();
+			GetSharedRsp(compileContent_, compileHash_, rspFile);
+			lastHash_ = compileHash_;
+			return true;
+		}
 
-			for (auto& c : flags) {
-				std::string line = ToAnsi(c) + "\n";
-				ofs.write(line.c_str(), line.size());
+		// Content of the compile rsp, one argument per line.
+		std::wstring CompileFlags() const {
+			std::wstring wide;
+			size_t size = 0;
+			for (auto id : model_.Flags())
+				size += model_.Str(id).size() + 1;
+			for (auto id : model_.IncludeDirs())
+				size += model_.Str(id).size() + 6;
+			wide.reserve(size);
+			for (auto id : model_.Flags()) {
+				wide.append(model_.Str(id)) += L'\n';
 			}
 
-			for (auto& d : inc) {
-				std::string line = ToAnsi(quote_w(L"-I" + d)) + "\n";
-				ofs.write(line.c_str(), line.size());
+			for (auto id : model_.IncludeDirs()) {
+				if (IsRelative(model_.Str(id)))
+					AppendQuoted(wide, L"-I" + Absolute(baseDir_, model_.Str(id)));
+				else
+					model_.AppendQuoted(wide, L"-I", id);
+				wide += L'\n';
 			}
-
-			index_++;
-			return true;
+			return wide;
 		}
 
 		const std::wstring CreateLinkRspFile(std::vector<std::wstring> links) {
-			auto rspPath = rspDir_ + L"/link.rsp";
-			std::ofstream  ofs(rspPath, std::ios::out | std::ios::trunc);
-			if (!ofs) {
-				std::wcerr << L"Cannot create file: " << rspPath << L"\n";
-				return L"";
+			auto rspPath = rspDir_ + (baseDir_.empty() ? L"/link.rsp" : L"/link_abs.rsp");
+
+			std::wstring wide;
+			size_t size = 4;
+			for (auto& link : links)
+				size += link.size() + 3;
+			for (auto* ids : { &model_.LinkTFlags(), &model_.LinkAsmFlags(), &model_.LinkFlags(), &model_.LinkLibrary() }) {
+				for (auto id : *ids)
+					size += model_.Str(id).size() + 10;
 			}
-			const auto& flagsT = model_.LinkTFlags();
-			const auto& flagsAsm = model_.LinkAsmFlags();
-			const auto& flags = model_.LinkFlags();
-			const auto& flagsLink = model_.LinkLibrary();
-			for (auto& c : flagsT) {
-				std::string line = "-Wl,-T " + ToAnsi(quote_w(c)) + "\n";
-				ofs.write(line.c_str(), line.size());
+			wide.reserve(size);
+			for (auto id : model_.LinkTFlags()) {
+				wide += L"-Wl,-T ";
+				if (IsRelative(model_.Str(id)))
+					AppendQuoted(wide, Absolute(baseDir_, model_.Str(id)));
+				else
+					model_.AppendQuoted(wide, L"", id);
+				wide += L'\n';
 			}
-			for (auto link : links)
+			for (auto& link : links)
 			{
-				std::string line = ToAnsi(quote_w(link)) + "\n";
-				ofs.write(line.c_str(), line.size());
+				AppendQuoted(wide, IsRelative(link) ? Absolute(baseDir_, link) : link);
+				wide += L'\n';
 			}
-			for (auto& c : flagsAsm) {
-				std::string line = ToAnsi(c) + "\n";
-				ofs.write(line.c_str(), line.size());
+			for (auto id : model_.LinkAsmFlags()) {
+				wide.append(model_.Str(id)) += L'\n';
 			}
-			for (auto& c : flags) {
-				std::string line = ToAnsi(c) + "\n";
-				ofs.write(line.c_str(), line.size());
+			for (auto id : model_.LinkFlags()) {
+				wide.append(model_.Str(id)) += L'\n';
 			}
 
-			for (auto& c: flagsLink)
+			for (auto id : model_.LinkLibrary())
 			{
-				std::string line = ToAnsi(c) + "\n";
-				ofs.write(line.c_str(), line.size());
+				wide.append(model_.Str(id)) += L'\n';
 			}
 
-			std::string lmFlag = "-lm";
-			ofs.write(lmFlag.c_str(), lmFlag.size());
+			wide += L"-lm";
+			std::string content = ToAnsi(wide);
+
+			if (!WriteIfChanged(rspPath, content))
+				return L"";
 
 			return rspPath;
 		}
 
+		// Relative include dirs, linker scripts and objects are written against
+		// dir, for files run from another directory than Build's. The compile
+		// rsp is named by its content already; the link rsp becomes
+		// link_abs.rsp so the one Build uses is left alone. Call before the
+		// first rsp is created.
+		void SetBaseDir(const std::wstring& dir) { baseDir_ = dir; }
+
+		// path taken against base when it is relative.
+		static std::wstring Absolute(const std::wstring& base, std::wstring_view path) {
+			std::filesystem::path p(path);
+			if (path.empty() || base.empty() || !p.is_relative())
+				return std::wstring(path);
+			return (std::filesystem::path(base) / p).lexically_normal().wstring();
+		}
+
+		uint64_t LastContentHash() const { return lastHash_; }
+
+		// True when CreateNextRspFile() named a file that Flush() has not written yet.
+		bool HasPending() const { return !pending_.empty(); }
+
+		// Writes the rsp files named since the last call. One file is written
+		// per distinct content, so this is at most a handful of writes. False
+		// when any of them could not be written.
+		bool Flush() {
+			bool ok = true;
+			for (auto& p : pending_)
+				ok = WriteIfChanged(p.path, *p.content) && ok;
+			pending_.clear();
+			return ok;
+		}
+
+		// Each rsp file check or write becomes a span.
+		void SetTracer(Tracer* tracer) { tracer_ = tracer; }
+
 	private:
 		const std::wstring rspDir_;
 		const ProjectModel& model_;
 
-		size_t index_ = 0;
-
-		std::string ToUtf8(const std::wstring& w) {
-			if (w.empty()) return {};
-			int size = WideCharToMultiByte(
-				CP_UTF8, 0,
-				w.data(), (int)w.size(),
-				nullptr, 0, nullptr, nullptr
-			);
-			std::string s(size, 0);
-			WideCharToMultiByte(
-				CP_UTF8, 0,
-				w.data(), (int)w.size(),
-				s.data(), size, nullptr, nullptr
-			);
-			return s;
+		uint64_t lastHash_ = 0;
+		bool compileReady_ = false;
+		std::string compileContent_;
+		uint64_t compileHash_ = 0;
+		std::unordered_map<uint64_t, std::wstring> sharedRsp_;
+		Tracer* tracer_ = nullptr;
+		std::wstring baseDir_;
+
+		struct Pending {
+			std::wstring path;
+			const std::string* content;
+		};
+		std::deque<Pending> pending_;
+
+		// Content must stay alive until Flush().
+		void GetSharedRsp(const std::string& content, uint64_t hash, std::wstring& rspFile) {
+			auto it = sharedRsp_.find(hash);
+			if (it != sharedRsp_.end()) {
+				rspFile = it->second;
+				return;
+			}
+
+			rspFile = rspDir_ + L"/compile_" + ToHex(hash) + L".rsp";
+			sharedRsp_.emplace(hash, rspFile);
+			pending_.push_back({ rspFile, &content });
+		}
+
+		bool WriteIfChanged(const std::wstring& path, const std::string& content) {
+			auto start = Tracer::Clock::now();
+			bool written = false;
+			bool ok = WriteIfDifferent(path, content, written);
+			if (tracer_ != nullptr)
+				tracer_->Span(L"write rsp", "rsp", start, Tracer::Clock::now(), TraceArgs().Add("file", path).Add("written", written ? 1 : 0));
+			return ok;
+		}
+
+		// Leaves the file (and its mtime) untouched when the content is the same,
+		// so incremental builds can treat the rsp as a flags input.
+		bool WriteIfDifferent(const std::wstring& path, const std::string& content, bool& written) {
+			{
+				MappedFile existing;
+				if (existing.Open(path) && existing.View() == content)
+					return true;
+			}
+
+			if (!platform::WriteWholeFile(path, content.data(), content.size())) {
+				std::wcerr << L"Cannot create file: " << path << L"\n";
+				return false;
+			}
+			written = true;
+			return true;
+		}
+
+		bool IsRelative(std::wstring_view path) const {
+			return !baseDir_.empty() && !path.empty() && std::filesystem::path(path).is_relative();
 		}
 
 		std::string ToAnsi(const std::wstring& wstr)
 		{
-			if (wstr.empty()) return {};
-			int size_needed = WideCharToMultiByte(1251, 0, wstr.c_str(), (int)wstr.size(), NULL, 0, NULL, NULL);
-			std::string strTo(size_needed, 0);
-			WideCharToMultiByte(1251, 0, wstr.c_str(), (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-			return strTo;
+			return platform::WideToNative(wstr);
 		}
-		std::wstring quote_w(const std::wstring& s) {
-			if (s.find_first_of(L" \t\"") == std::wstring::npos) return s;
-			std::wstring res = L"\"";
+		static void AppendQuoted(std::wstring& out, const std::wstring& s) {
+			if (s.find_first_of(L" \t\"") == std::wstring::npos) {
+				out += s;
+				return;
+			}
+			out += L'"';
 			for (wchar_t c : s) {
-				if (c == L'"') res += L"\\\""; else res.push_back(c);
+				if (c == L'"') out += L"\\\""; else out.push_back(c);
 			}
-			res += L"\"";
-			return res;
+			out += L'"';
 		}
 	};
 }
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CMAKEPARSER_SCAN_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CMAKEPARSER_SCAN_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace cmakeparser {
+
+	namespace scan_detail {
+		inline unsigned Ctz(uint32_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long i;
+			_BitScanForward(&i, v);
+			return (unsigned)i;
+#else
+			return (unsigned)__builtin_ctz(v);
+#endif
+		}
+
+		inline int Popcount(uint32_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+			return (int)__popcnt(v);
+#else
+			return __builtin_popcount(v);
+#endif
+		}
+
+		inline bool IsSpace(char c) {
+			return c == ' ' || (unsigned char)(c - 9) <= 4;
+		}
+
+		template<char... Cs>
+		inline bool IsAny(char c) {
+			return ((c == Cs) || ...);
+		}
+	}
+
+	// Byte-at-a-time reference implementation; also the tail handler for SimdScanner.
+	struct ScalarScanner
+	{
+		// First index in [from, n) holding one of Cs, or n.
+		template<char... Cs>
+		static size_t FindAny(const char* p, size_t from, size_t n) {
+			while (from < n && !scan_detail::IsAny<Cs...>(p[from])) from++;
+			return from;
+		}
+
+		// First non-blank index in [from, n), or n; adds skipped newlines to lines.
+		static size_t SkipSpaces(const char* p, size_t from, size_t n, int& lines) {
+			while (from < n && scan_detail::IsSpace(p[from])) {
+				if (p[from] == '\n') lines++;
+				from++;
+			}
+			return from;
+		}
+	};
+
+	// Classifies 32 (AVX2) or 16 (SSE2) bytes per step; falls back to the scalar
+	// loop for the tail and on targets without SSE2.
+	struct SimdScanner
+	{
+		template<char... Cs>
+		static size_t FindAny(const char* p, size_t from, size_t n) {
+#if CMAKEPARSER_SCAN_AVX2
+			while (from + 32 <= n) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + from));
+				__m256i hit = _mm256_setzero_si256();
+				((hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(Cs)))), ...);
+				uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+				if (mask != 0)
+					return from + scan_detail::Ctz(mask);
+				from += 32;
+			}
+#endif
+#if CMAKEPARSER_SCAN_SSE2
+			while (from + 16 <= n) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + from));
+				__m128i hit = _mm_setzero_si128();
+				((hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(Cs)))), ...);
+				uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+				if (mask != 0)
+					return from + scan_detail::Ctz(mask);
+				from += 16;
+			}
+#endif
+			return ScalarScanner::FindAny<Cs...>(p, from, n);
+		}
+
+		static size_t SkipSpaces(const char* p, size_t from, size_t n, int& lines) {
+			// Blank runs are usually a few bytes; stay scalar until one gets long.
+			size_t stop = from + 8 < n ? from + 8 : n;
+			while (from < stop) {
+				char c = p[from];
+				if (!scan_detail::IsSpace(c))
+					return from;
+				if (c == '\n') lines++;
+				from++;
+			}
+#if CMAKEPARSER_SCAN_SSE2
+			const __m128i nine = _mm_set1_epi8(9);
+			const __m128i four = _mm_set1_epi8(4);
+			const __m128i blank = _mm_set1_epi8(' ');
+			const __m128i newline = _mm_set1_epi8('\n');
+			while (from + 16 <= n) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + from));
+				__m128i t = _mm_sub_epi8(v, nine);
+				__m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(t, four), t);
+				__m128i space = _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, blank));
+				uint32_t nonSpace = ~(uint32_t)_mm_movemask_epi8(space) & 0xFFFFu;
+				uint32_t nl = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+				if (nonSpace != 0) {
+					unsigned idx = scan_detail::Ctz(nonSpace);
+					lines += scan_detail::Popcount(nl & ((1u << idx) - 1));
+					return from + idx;
+				}
+				lines += scan_detail::Popcount(nl);
+				from += 16;
+			}
+#endif
+			return ScalarScanner::SkipSpaces(p, from, n, lines);
+		}
+	};
+}
\ No newline at end of file
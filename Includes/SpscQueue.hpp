@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cmakeparser {
+
+	// Bounded single-producer/single-consumer ring. Push() and Pop() take no
+	// lock; a full or empty ring blocks on an atomic wait (a futex on Linux,
+	// WaitOnAddress on Windows) instead of spinning. Close() ends the stream:
+	// Pop() drains what is left and then returns false. Cancel() is the
+	// consumer's way of telling the producer to stop.
+	template<class T>
+	class SpscQueue
+	{
+	public:
+		explicit SpscQueue(size_t capacity) {
+			size_t size = 1;
+			while (size < capacity)
+				size <<= 1;
+			slots_.resize(size);
+			mask_ = size - 1;
+		}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		// Producer side; waits while the ring is full. False once the consumer
+		// has called Cancel().
+		bool Push(T value) {
+			size_t tail = tail_.load(std::memory_order_relaxed);
+			for (;;) {
+				uint32_t seen = space_.load(std::memory_order_acquire);
+				if (cancelled_.load(std::memory_order_acquire))
+					return false;
+				if (tail - head_.load(std::memory_order_acquire) < slots_.size())
+					break;
+				space_.wait(seen, std::memory_order_acquire);
+			}
+			slots_[tail & mask_] = std::move(value);
+			tail_.store(tail + 1, std::memory_order_release);
+			Signal();
+			return true;
+		}
+
+		// Producer side; no more values follow.
+		void Close() {
+			closed_.store(true, std::memory_order_release);
+			Signal();
+		}
+
+		// Consumer side; waits for a value. False when the queue is closed and empty.
+		bool Pop(T& out) {
+			size_t head = head_.load(std::memory_order_relaxed);
+			for (;;) {
+				uint32_t seen = events_.load(std::memory_order_acquire);
+				if (tail_.load(std::memory_order_acquire) != head)
+					break;
+				if (closed_.load(std::memory_order_acquire)) {
+					if (tail_.load(std::memory_order_acquire) != head)
+						break;
+					return false;
+				}
+				events_.wait(seen, std::memory_order_acquire);
+			}
+			Take(head, out);
+			return true;
+		}
+
+		// Consumer side; false when nothing is queued right now.
+		bool TryPop(T& out) {
+			size_t head = head_.load(std::memory_order_relaxed);
+			if (tail_.load(std::memory_order_acquire) == head)
+				return false;
+			Take(head, out);
+			return true;
+		}
+
+		// Consumer side; the producer's next (or blocked) Push() returns false.
+		void Cancel() {
+			cancelled_.store(true, std::memory_order_release);
+			space_.fetch_add(1, std::memory_order_release);
+			space_.notify_one();
+		}
+
+	private:
+		std::vector<T> slots_;
+		size_t mask_ = 0;
+		alignas(64) std::atomic<size_t> head_{ 0 };
+		alignas(64) std::atomic<size_t> tail_{ 0 };
+		// Bumped on every Push() and Close(), and on every Pop() and Cancel(),
+		// so each side sleeps on a single word.
+		alignas(64) std::atomic<uint32_t> events_{ 0 };
+		alignas(64) std::atomic<uint32_t> space_{ 0 };
+		std::atomic<bool> closed_{ false };
+		std::atomic<bool> cancelled_{ false };
+
+		void Take(size_t head, T& out) {
+			out = std::move(slots_[head & mask_]);
+			head_.store(head + 1, std::memory_order_release);
+			space_.fetch_add(1, std::memory_order_release);
+			space_.notify_one();
+		}
+
+		void Signal() {
+			events_.fetch_add(1, std::memory_order_release);
+			events_.notify_one();
+		}
+	};
+}
\ No newline at end of file
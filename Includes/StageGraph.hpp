@@ -0,0 +1,140 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Task.h"
+#include "Trace.hpp"
+
+namespace cmakeparser {
+
+	// Small dependency graph for the build stages. A stage starts as soon as all
+	// of its dependencies have finished with code 0; if one fails, everything
+	// depending on it is skipped and Run() returns the first failing code.
+	class StageGraph
+	{
+	public:
+		using StageFn = std::function<int()>;
+
+		// onCaller stages run on the thread that calls Run(); use it for stages
+		// that mostly wait (the compile dispatcher) so they do not hold a pool thread.
+		size_t Add(const std::wstring& name, StageFn fn, std::initializer_list<size_t> deps = {}, bool onCaller = false) {
+			size_t id = stages_.size();
+			Stage stage;
+			stage.name = name;
+			stage.fn = std::move(fn);
+			stage.onCaller = onCaller;
+			stage.pending = deps.size();
+			stages_.push_back(std::move(stage));
+			for (auto d : deps)
+				stages_[d].dependents.push_back(id);
+			return id;
+		}
+
+		int Run() {
+			std::vector<Task<void>> tasks;
+			tasks.reserve(stages_.size());
+			std::vector<size_t> ready;
+			for (size_t i = 0; i < stages_.size(); ++i) {
+				if (stages_[i].pending == 0)
+					ready.push_back(i);
+			}
+
+			std::unique_lock<std::mutex> lk(mutex_);
+			while (finished_ < stages_.size()) {
+				ready.insert(ready.end(), newlyReady_.begin(), newlyReady_.end());
+				newlyReady_.clear();
+
+				std::vector<size_t> onCaller;
+				for (auto id : ready) {
+					if (stages_[id].onCaller) {
+						onCaller.push_back(id);
+						continue;
+					}
+					Task<void> task([this, id] {
+						Complete(id, RunStage(id));
+					});
+					task.Start(TaskPriority::High, TaskBound::IOBound);
+					tasks.push_back(std::move(task));
+				}
+				ready.clear();
+
+				if (!onCaller.empty()) {
+					lk.unlock();
+					for (auto id : onCaller)
+						Complete(id, RunStage(id));
+					lk.lock();
+					continue;
+				}
+
+				if (newlyReady_.empty() && finished_ < stages_.size())
+					cv_.wait(lk, [this] { return !newlyReady_.empty() || finished_ >= stages_.size(); });
+			}
+			lk.unlock();
+
+			WaitAll(tasks);
+			return firstError_;
+		}
+
+		// Every stage that runs becomes a span named after it.
+		void SetTracer(Tracer* tracer) { tracer_ = tracer; }
+
+	private:
+		struct Stage {
+			std::wstring name;
+			StageFn fn;
+			bool onCaller = false;
+			bool skipped = false;
+			size_t pending = 0;
+			std::vector<size_t> dependents;
+		};
+
+		std::vector<Stage> stages_;
+		std::vector<size_t> newlyReady_;
+		size_t finished_ = 0;
+		int firstError_ = 0;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		Tracer* tracer_ = nullptr;
+
+		int RunStage(size_t id) {
+			auto start = Tracer::Clock::now();
+			int code = stages_[id].fn();
+			if (tracer_ != nullptr)
+				tracer_->Span(stages_[id].name, "stage", start, Tracer::Clock::now(), TraceArgs().Add("code", code));
+			return code;
+		}
+
+		void Complete(size_t id, int code) {
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				finished_++;
+				if (code != 0) {
+					if (firstError_ == 0)
+						firstError_ = code;
+					Skip(id);
+				}
+				else {
+					for (auto d : stages_[id].dependents) {
+						if (!stages_[d].skipped && --stages_[d].pending == 0)
+							newlyReady_.push_back(d);
+					}
+				}
+			}
+			cv_.notify_all();
+		}
+
+		void Skip(size_t id) {
+			for (auto d : stages_[id].dependents) {
+				if (stages_[d].skipped)
+					continue;
+				stages_[d].skipped = true;
+				finished_++;
+				Skip(d);
+			}
+		}
+	};
+}
\ No newline at end of file
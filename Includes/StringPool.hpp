@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Hash.hpp"
+
+namespace cmakeparser {
+
+	// Interns strings to dense 32-bit ids. Characters are packed into large
+	// arena blocks, so views returned by Get() stay valid until Clear(); ids are
+	// assigned in insertion order.
+	template<class CharT>
+	class BasicStringPool
+	{
+	public:
+		using View = std::basic_string_view<CharT>;
+		static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+		uint32_t Intern(View s) {
+			if ((strings_.size() + 1) * 4 >= table_.size() * 3)
+				Grow();
+
+			uint64_t hash = HashString(s);
+			size_t mask = table_.size() - 1;
+			for (size_t i = hash & mask;; i = (i + 1) & mask) {
+				auto& slot = table_[i];
+				if (slot.id == kNone) {
+					slot.hash = hash;
+					slot.id = (uint32_t)strings_.size();
+					strings_.push_back(Copy(s));
+					return slot.id;
+				}
+				if (slot.hash == hash && strings_[slot.id] == s)
+					return slot.id;
+			}
+		}
+
+		uint32_t Find(View s) const {
+			uint64_t hash = HashString(s);
+			size_t mask = table_.size() - 1;
+			for (size_t i = hash & mask;; i = (i + 1) & mask) {
+				auto& slot = table_[i];
+				if (slot.id == kNone)
+					return kNone;
+				if (slot.hash == hash && strings_[slot.id] == s)
+					return slot.id;
+			}
+		}
+
+		View Get(uint32_t id) const { return strings_[id]; }
+		size_t Size() const { return strings_.size(); }
+
+		void Clear() {
+			strings_.clear();
+			std::fill(table_.begin(), table_.end(), Slot{});
+			if (blocks_.size() > 1)
+				blocks_.resize(1);
+			blockUsed_ = 0;
+			blockSize_ = blocks_.empty() ? 0 : kBlockChars;
+		}
+
+	private:
+		struct Slot {
+			uint64_t hash = 0;
+			uint32_t id = kNone;
+		};
+
+		static constexpr size_t kInitialCapacity = 64;
+		static constexpr size_t kBlockChars = 16 * 1024;
+
+		std::vector<View> strings_;
+		std::vector<Slot> table_ = std::vector<Slot>(kInitialCapacity);
+		std::vector<std::unique_ptr<CharT[]>> blocks_;
+		size_t blockUsed_ = 0;
+		size_t blockSize_ = 0;
+
+		View Copy(View s) {
+			if (s.empty())
+				return View();
+			if (blockSize_ - blockUsed_ < s.size()) {
+				size_t size = std::max(kBlockChars, s.size());
+				// An oversized string gets its own block, the current one stays open.
+				if (size > kBlockChars && !blocks_.empty()) {
+					blocks_.insert(blocks_.end() - 1, std::make_unique<CharT[]>(size));
+					CharT* p = blocks_[blocks_.size() - 2].get();
+					std::copy(s.begin(), s.end(), p);
+					return View(p, s.size());
+				}
+				blocks_.push_back(std::make_unique<CharT[]>(size));
+				blockUsed_ = 0;
+				blockSize_ = size;
+			}
+			CharT* p = blocks_.back().get() + blockUsed_;
+			std::copy(s.begin(), s.end(), p);
+			blockUsed_ += s.size();
+			return View(p, s.size());
+		}
+
+		void Grow() {
+			std::vector<Slot> old(table_.size() * 2);
+			old.swap(table_);
+			size_t mask = table_.size() - 1;
+			for (auto& s : old) {
+				if (s.id == kNone)
+					continue;
+				size_t i = s.hash & mask;
+				while (table_[i].id != kNone)
+					i = (i + 1) & mask;
+				table_[i] = s;
+			}
+		}
+	};
+
+	using StringPool = BasicStringPool<char>;
+	using WStringPool = BasicStringPool<wchar_t>;
+
+	// Open-addressing map from pool ids to values; values are stored densely in
+	// insertion order.
+	template<class V>
+	class IdMap
+	{
+	public:
+		V& operator[](uint32_t key) {
+			if ((entries_.size() + 1) * 4 >= slots_.size() * 3)
+				Grow();
+			size_t mask = slots_.size() - 1;
+			for (size_t i = Mix(key) & mask;; i = (i + 1) & mask) {
+				if (slots_[i] == kEmpty) {
+					slots_[i] = (uint32_t)entries_.size();
+					entries_.emplace_back(key, V{});
+					return entries_.back().second;
+				}
+				if (entries_[slots_[i]].first == key)
+					return entries_[slots_[i]].second;
+			}
+		}
+
+		const V* Find(uint32_t key) const {
+			size_t mask = slots_.size() - 1;
+			for (size_t i = Mix(key) & mask;; i = (i + 1) & mask) {
+				if (slots_[i] == kEmpty)
+					return nullptr;
+				if (entries_[slots_[i]].first == key)
+					return &entries_[slots_[i]].second;
+			}
+		}
+
+		const std::vector<std::pair<uint32_t, V>>& Entries() const { return entries_; }
+		size_t Size() const { return entries_.size(); }
+
+	private:
+		static constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+
+		std::vector<uint32_t> slots_ = std::vector<uint32_t>(16, kEmpty);
+		std::vector<std::pair<uint32_t, V>> entries_;
+
+		static size_t Mix(uint32_t key) {
+			return (size_t)(key * 0x9E3779B1u);
+		}
+
+		void Grow() {
+			slots_.assign(slots_.size() * 2, kEmpty);
+			size_t mask = slots_.size() - 1;
+			for (uint32_t e = 0; e < entries_.size(); ++e) {
+				size_t i = Mix(entries_[e].first) & mask;
+				while (slots_[i] != kEmpty)
+					i = (i + 1) & mask;
+				slots_[i] = e;
+			}
+		}
+	};
+}
\ No newline at end of file
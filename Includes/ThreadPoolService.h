@@ -2,12 +2,14 @@
 
 #include "ThreadPool.h"
 #include "memory"
-#include "ProcessRunGuard.h"
+#include "ProcessRunner.hpp"
 
 class ThreadPoolService {
 public:
-    static ThreadPoolService& Instance() {
-        static ThreadPoolService instance;
+    // The first call decides the pool size; minThreads lets -j N ask for more
+    // threads than hardware_concurrency.
+    static ThreadPoolService& Instance(size_t minThreads = 0) {
+        static ThreadPoolService instance(minThreads);
         return instance;
     }
 
@@ -21,9 +23,10 @@ public:
     ThreadPool& Pool() { return *pool_; }
 
 private:
-    ThreadPoolService() {
+    explicit ThreadPoolService(size_t minThreads) {
         size_t threads = std::thread::hardware_concurrency();
         if (threads == 0) threads = 4;
+        if (threads < minThreads) threads = minThreads;
         pool_ = std::make_unique<ThreadPool>(threads);
     }
 
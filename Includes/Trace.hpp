@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Platform.hpp"
+
+namespace cmakeparser {
+
+	// Argument object of a trace event, built as JSON members.
+	class TraceArgs
+	{
+	public:
+		TraceArgs& Add(const char* key, int64_t value) {
+			Key(key);
+			json_ += std::to_string(value);
+			return *this;
+		}
+
+		TraceArgs& Add(const char* key, std::wstring_view value) {
+			Key(key);
+			json_ += '"';
+			AppendEscaped(json_, platform::WideToUtf8(value));
+			json_ += '"';
+			return *this;
+		}
+
+		const std::string& Json() const { return json_; }
+
+		static void AppendEscaped(std::string& out, std::string_view s) {
+			for (char c : s) {
+				if (c == '"' || c == '\\') {
+					out += '\\';
+					out += c;
+				}
+				else if ((unsigned char)c < 0x20) {
+					static const char* hex = "0123456789abcdef";
+					out += "\\u00";
+					out += hex[(c >> 4) & 0xF];
+					out += hex[c & 0xF];
+				}
+				else {
+					out += c;
+				}
+			}
+		}
+
+	private:
+		std::string json_;
+
+		void Key(const char* key) {
+			if (!json_.empty())
+				json_ += ',';
+			json_ += '"';
+			json_ += key;
+			json_ += "\":";
+		}
+	};
+
+	// Collects Chrome trace-event JSON (--trace out.json, open in Perfetto or
+	// chrome://tracing). Spans run on the thread that records them; child
+	// processes overlap freely, so they are laid out on "process slot" tracks
+	// instead, a span going to the first slot that is free at its start.
+	// A disabled tracer records nothing.
+	class Tracer
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		void Enable() {
+			enabled_ = true;
+			origin_ = Clock::now();
+		}
+
+		bool Enabled() const { return enabled_; }
+
+		void Span(std::wstring_view name, const char* category, Clock::time_point start, Clock::time_point end, const TraceArgs& args = {}) {
+			if (!enabled_)
+				return;
+			Record(name, category, start, end, ThreadId(), args);
+		}
+
+		void SlotSpan(std::wstring_view name, const char* category, Clock::time_point start, Clock::time_point end, const TraceArgs& args = {}) {
+			if (!enabled_)
+				return;
+			int64_t from = Micros(start);
+			uint32_t slot = 0;
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				while (slot < slotEnds_.size() && slotEnds_[slot] > from)
+					slot++;
+				if (slot == slotEnds_.size())
+					slotEnds_.push_back(0);
+				slotEnds_[slot] = Micros(end);
+			}
+			Record(name, category, start, end, kSlotTid + slot, args);
+		}
+
+		// Small stable number per thread, in order of the first recorded span.
+		static uint32_t ThreadId() {
+			static std::atomic<uint32_t> next{ 1 };
+			thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+			return id;
+		}
+
+		// Writes the spans recorded since the last Write() and drops them, so a
+		// --watch session holds one build's trace, not every build so far.
+		bool Write(const std::wstring& path) {
+			std::vector<Event> events;
+			std::vector<int64_t> slotEnds;
+			{
+				std::lock_guard<std::mutex> lk(mutex_);
+				events.swap(events_);
+				slotEnds.swap(slotEnds_);
+			}
+
+			std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			for (size_t slot = 0; slot < slotEnds.size(); ++slot) {
+				json += "{\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(kSlotTid + slot);
+				json += ",\"name\":\"thread_name\",\"args\":{\"name\":\"process slot " + std::to_string(slot + 1) + "\"}},\n";
+			}
+			for (size_t i = 0; i < events.size(); ++i) {
+				auto& e = events[i];
+				json += "{\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(e.tid);
+				json += ",\"ts\":" + std::to_string(e.ts) + ",\"dur\":" + std::to_string(e.dur);
+				json += ",\"cat\":\"";
+				json += e.category;
+				json += "\",\"name\":\"";
+				TraceArgs::AppendEscaped(json, e.name);
+				json += "\",\"args\":{" + e.args + "}}";
+				json += i + 1 < events.size() ? ",\n" : "\n";
+			}
+			json += "]}\n";
+
+			std::ofstream ofs(std::filesystem::path(path), std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!ofs) {
+				std::wcerr << L"Cannot create file: " << path << L"\n";
+				return false;
+			}
+			ofs.write(json.data(), json.size());
+			return (bool)ofs;
+		}
+
+	private:
+		static constexpr uint32_t kSlotTid = 1000;
+
+		struct Event {
+			std::string name;
+			const char* category;
+			int64_t ts;
+			int64_t dur;
+			uint32_t tid;
+			std::string args;
+		};
+
+		bool enabled_ = false;
+		Clock::time_point origin_;
+		mutable std::mutex mutex_;
+		std::vector<Event> events_;
+		std::vector<int64_t> slotEnds_;
+
+		int64_t Micros(Clock::time_point t) const {
+			return std::chrono::duration_cast<std::chrono::microseconds>(t - origin_).count();
+		}
+
+		void Record(std::wstring_view name, const char* category, Clock::time_point start, Clock::time_point end, uint32_t tid, const TraceArgs& args) {
+			Event e{ platform::WideToUtf8(name), category, Micros(start), Micros(end) - Micros(start), tid, args.Json() };
+			std::lock_guard<std::mutex> lk(mutex_);
+			events_.push_back(std::move(e));
+		}
+	};
+
+	// Records the enclosing block as one span; name must outlive the scope.
+	class TraceScope
+	{
+	public:
+		TraceScope(Tracer& tracer, std::wstring_view name, const char* category)
+			: tracer_(tracer), name_(name), category_(category), start_(Tracer::Clock::now()) {
+		}
+
+		~TraceScope() {
+			tracer_.Span(name_, category_, start_, Tracer::Clock::now(), args_);
+		}
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+		TraceArgs& Args() { return args_; }
+
+	private:
+		Tracer& tracer_;
+		std::wstring_view name_;
+		const char* category_;
+		Tracer::Clock::time_point start_;
+		TraceArgs args_;
+	};
+}
\ No newline at end of file
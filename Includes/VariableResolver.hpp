@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Ast.hpp"
+#include "Platform.hpp"
+#include "StringPool.hpp"
+
+namespace cmakeparser {
+
+	// CMake variable store. As in CMake, set() arguments are expanded by the
+	// caller (ExpandArgs) and the variable holds the result, a ';'-separated
+	// list; reading ${VAR} never expands the value again. The element list of
+	// a value is split once and memoized, so the many ${SRC}-style arguments
+	// that are a lone reference cost a copy, not a re-split.
+	//
+	// Supports nested references (${${PREFIX}_DIR}), $ENV{NAME} and directory
+	// scopes. Undefined variables expand to "".
+	class VariableResolver
+	{
+	public:
+		// value is stored as given.
+		void Set(std::string_view name, std::string_view value) {
+			Bind(names_.Intern(name), std::string(value), true);
+		}
+
+		// Expanded set() arguments, stored as a list.
+		void Set(std::string_view name, const std::vector<std::string>& values) {
+			std::string joined;
+			for (size_t i = 0; i < values.size(); ++i) {
+				if (i) joined += ';';
+				joined += values[i];
+			}
+			Set(name, joined);
+		}
+
+		void Unset(std::string_view name) {
+			Bind(names_.Intern(name), std::string(), false);
+		}
+
+		bool IsDefined(std::string_view name) const {
+			uint32_t id = names_.Find(name);
+			return id != StringPool::kNone && id < vars_.size() && vars_[id].defined;
+		}
+
+		const std::string& Get(std::string_view name) {
+			return Var(names_.Intern(name)).value;
+		}
+
+		std::string Expand(std::string_view text) {
+			std::string out;
+			ExpandInto(text, out);
+			return out;
+		}
+
+		// Expands args[from..]; unquoted args are split into list elements and
+		// empty elements dropped, quoted ones stay a single value, bracket args
+		// are taken literally.
+		void ExpandArgs(std::span<const std::string_view> args, std::span<const ArgKind> kinds, size_t from, std::vector<std::string>& out) {
+			out.clear();
+			for (size_t i = from; i < args.size(); ++i) {
+				bool split = kinds[i] == ArgKind::Unquoted && args[i].find('\\') != std::string_view::npos;
+				if (kinds[i] == ArgKind::Bracket || (!split && args[i].find('$') == std::string_view::npos)) {
+					out.emplace_back(args[i]);
+					continue;
+				}
+				if (kinds[i] == ArgKind::Unquoted) {
+					if (auto* list = LoneReference(args[i])) {
+						out.insert(out.end(), list->begin(), list->end());
+						continue;
+					}
+				}
+				std::string value;
+				ExpandInto(args[i], value);
+				if (kinds[i] == ArgKind::Quoted) {
+					out.push_back(std::move(value));
+					continue;
+				}
+				Split(value, out);
+			}
+		}
+
+		// Directory scope: assignments after PushScope() are undone by PopScope().
+		void PushScope() { scopes_.push_back(undo_.size()); }
+
+		void PopScope() {
+			if (scopes_.empty())
+				return;
+			size_t mark = scopes_.back();
+			scopes_.pop_back();
+			while (undo_.size() > mark) {
+				auto& u = undo_.back();
+				Rebind(u.id, std::move(u.value), u.defined);
+				undo_.pop_back();
+			}
+		}
+
+		// Names read through $ENV{}; the model cache is only valid while they keep their values.
+		const std::vector<std::string>& EnvReads() const { return envReads_; }
+
+		void Reset() {
+			names_.Clear();
+			vars_.clear();
+			undo_.clear();
+			scopes_.clear();
+			envReads_.clear();
+		}
+
+	private:
+		struct Variable {
+			std::string value;
+			// Non-empty elements of value, split on first use.
+			std::vector<std::string> list;
+			bool defined = false;
+			bool listReady = false;
+		};
+
+		struct Undo {
+			uint32_t id;
+			std::string value;
+			bool defined;
+		};
+
+		StringPool names_;
+		// deque: expansion recurses while new names are interned, references
+		// to existing entries must stay valid.
+		std::deque<Variable> vars_;
+		std::vector<Undo> undo_;
+		std::vector<size_t> scopes_;
+		std::vector<std::string> envReads_;
+
+		Variable& Var(uint32_t id) {
+			while (vars_.size() <= id)
+				vars_.emplace_back();
+			return vars_[id];
+		}
+
+		void Bind(uint32_t id, std::string&& value, bool defined) {
+			if (!scopes_.empty()) {
+				auto& v = Var(id);
+				undo_.push_back({ id, v.value, v.defined });
+			}
+			Rebind(id, std::move(value), defined);
+		}
+
+		void Rebind(uint32_t id, std::string&& value, bool defined) {
+			auto& v = Var(id);
+			v.value = std::move(value);
+			v.defined = defined;
+			v.list.clear();
+			v.listReady = false;
+		}
+
+		// As in CMake, "\;" is a literal ';' inside an element.
+		static void Split(const std::string& value, std::vector<std::string>& out) {
+			if (value.find("\\;") != std::string::npos) {
+				SplitEscaped(value, out);
+				return;
+			}
+			size_t start = 0;
+			for (size_t pos; (pos = value.find(';', start)) != std::string::npos; start = pos + 1) {
+				if (pos > start)
+					out.emplace_back(value, start, pos - start);
+			}
+			if (value.size() > start)
+				out.emplace_back(value, start);
+		}
+
+		static void SplitEscaped(const std::string& value, std::vector<std::string>& out) {
+			std::string element;
+			for (size_t i = 0; i < value.size(); ++i) {
+				if (value[i] == '\\' && i + 1 < value.size() && value[i + 1] == ';') {
+					element += ';';
+					i++;
+				}
+				else if (value[i] == ';') {
+					if (!element.empty())
+						out.push_back(std::move(element));
+					element.clear();
+				}
+				else {
+					element += value[i];
+				}
+			}
+			if (!element.empty())
+				out.push_back(std::move(element));
+		}
+
+		// The memoized elements when arg is exactly ${NAME} with a plain name.
+		const std::vector<std::string>* LoneReference(std::string_view arg) {
+			if (arg.size() < 4 || arg[0] != '$' || arg[1] != '{' || arg.back() != '}')
+				return nullptr;
+			auto name = arg.substr(2, arg.size() - 3);
+			if (name.find_first_of("${}") != std::string_view::npos)
+				return nullptr;
+			auto& v = Var(names_.Intern(name));
+			if (!v.listReady) {
+				Split(v.value, v.list);
+				v.listReady = true;
+			}
+			return &v.list;
+		}
+
+		// Index of the '}' closing a reference whose name starts at from,
+		// skipping nested ${...}; npos if unterminated.
+		static size_t FindClose(std::string_view s, size_t from) {
+			int depth = 1;
+			for (size_t i = from; i < s.size(); ++i) {
+				if (s[i] == '{' && i > 0 && s[i - 1] == '$') depth++;
+				else if (s[i] == '}' && --depth == 0) return i;
+			}
+			return std::string_view::npos;
+		}
+
+		void ExpandInto(std::string_view s, std::string& out) {
+			size_t i = 0;
+			while (i < s.size()) {
+				size_t dollar = s.find('$', i);
+				if (dollar == std::string_view::npos) {
+					out.append(s.substr(i));
+					return;
+				}
+				out.append(s.substr(i, dollar - i));
+
+				bool env = s.compare(dollar + 1, 4, "ENV{") == 0;
+				size_t open = env ? dollar + 4 : dollar + 1;
+				size_t close = open < s.size() && s[open] == '{' ? FindClose(s, open + 1) : std::string_view::npos;
+				if (close == std::string_view::npos) {
+					out += '$';
+					i = dollar + 1;
+					continue;
+				}
+
+				auto nameText = s.substr(open + 1, close - open - 1);
+				std::string name;
+				if (nameText.find('$') != std::string_view::npos)
+					ExpandInto(nameText, name);
+				else
+					name.assign(nameText);
+
+				if (env) {
+					if (std::find(envReads_.begin(), envReads_.end(), name) == envReads_.end())
+						envReads_.push_back(name);
+					out += platform::GetEnvUtf8(name);
+				}
+				else {
+					out += Var(names_.Intern(name)).value;
+				}
+				i = close + 1;
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Checks CmakeLexer's escape sequences against CMake's: encoded \t \n \r,
+// identity escapes, "\;" kept as written, and an error with the line number
+// for any other "\" before a letter or digit (Windows paths in particular).
+// Usage: CmakeParser_lexer_check (exit code 0 when every case passes)
+
+#include "CmakeLexer.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace cmakeparser;
+
+static std::string Show(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '\t') out += "<TAB>";
+        else if (c == '\n') out += "<LF>";
+        else if (c == '\r') out += "<CR>";
+        else out += c;
+    }
+    return out;
+}
+
+// Args of the last command, joined with '|'.
+static bool CheckArgs(const char* what, const std::string& text, const std::string& expected)
+{
+    AST ast;
+    CmakeLexer lexer(text);
+    lexer.Lex(ast);
+    std::string got;
+    if (!ast.Commands().empty()) {
+        auto args = ast.Args(ast.Commands().back());
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (i) got += '|';
+            got += args[i];
+        }
+    }
+    if (lexer.Error().empty() && got == expected) {
+        std::printf("ok    %s\n", what);
+        return true;
+    }
+    std::printf("FAIL  %s: args \"%s\", expected \"%s\"%s%s\n", what, Show(got).c_str(), Show(expected).c_str(),
+        lexer.Error().empty() ? "" : ", error: ", lexer.Error().c_str());
+    return false;
+}
+
+static bool CheckError(const char* what, const std::string& text, const std::string& error, int line)
+{
+    AST ast;
+    CmakeLexer lexer(text);
+    lexer.Lex(ast);
+    if (lexer.Error() == error && lexer.ErrorLine() == line) {
+        std::printf("ok    %s\n", what);
+        return true;
+    }
+    std::printf("FAIL  %s: error \"%s\" at line %d, expected \"%s\" at line %d\n", what, lexer.Error().c_str(), lexer.ErrorLine(), error.c_str(), line);
+    return false;
+}
+
+int main()
+{
+    bool ok = true;
+    ok = CheckError("unquoted Windows path",
+        "project(P)\nset(BASE_DIR C:\\Work\\tools\\fw)\n", "Invalid escape sequence \\W", 2) && ok;
+    ok = CheckError("quoted Windows path",
+        "set(A a)\n\nset(P \"D:\\Projects\\new\")\n", "Invalid escape sequence \\P", 3) && ok;
+    ok = CheckError("digit after backslash",
+        "set(X a\\1)\n", "Invalid escape sequence \\1", 1) && ok;
+    ok = CheckArgs("forward slashes need no escapes",
+        "set(BASE_DIR C:/Work/tools/fw)\n", "BASE_DIR|C:/Work/tools/fw") && ok;
+    ok = CheckArgs("encoded escapes",
+        "set(X \"a\\tb\\nc\\rd\")\n", "X|a\tb\nc\rd") && ok;
+    ok = CheckArgs("identity escapes",
+        "set(X a\\ b \"q\\\"x\" \\$\\{Y\\} \\\\)\n", "X|a b|q\"x|${Y}|\\") && ok;
+    ok = CheckArgs("\\; is kept and does not split",
+        "set(X a\\;b c;d \"e\\;f\")\n", "X|a\\;b|c|d|e\\;f") && ok;
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+// Checks set() and ${} against CMake's semantics: each case is written to a
+// temporary CMakeLists.txt, run through CmakeParser::Parse and the value the
+// model recorded for the last set() of a variable is compared.
+// Usage: CmakeParser_resolver_check (exit code 0 when every case passes)
+
+#include "CmakeParser.hpp"
+#include "ThreadPoolService.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace cmakeparser;
+
+static bool WriteText(const std::filesystem::path& path, const std::string& text)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        std::fprintf(stderr, "cannot create %s\n", path.string().c_str());
+        return false;
+    }
+    ofs << text;
+    return true;
+}
+
+// The ';'-joined values of the model's set() entry for name.
+static bool FindSet(const ProjectModel& model, const std::string& name, std::string& value)
+{
+    auto wide = platform::Utf8ToWide(name);
+    for (auto& [key, values] : model.Sets().Entries()) {
+        if (model.Str(key) != wide)
+            continue;
+        std::wstring joined;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i) joined += L';';
+            joined += model.Str(values[i]);
+        }
+        value = platform::WideToUtf8(joined);
+        return true;
+    }
+    return false;
+}
+
+struct File {
+    const char* path;
+    std::string text;
+};
+
+// files[0] is the root list file; BASE_DIR is set to the case directory first.
+static bool Check(const std::filesystem::path& dir, const char* what, std::initializer_list<File> files, const char* name, const std::string& expected)
+{
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    auto root = dir / files.begin()->path;
+    for (auto& file : files) {
+        auto text = file.text;
+        if (&file == files.begin())
+            text = "set(BASE_DIR " + dir.generic_string() + ")\n" + text;
+        if (!WriteText(dir / file.path, text))
+            return false;
+    }
+
+    auto quiet = [](const wchar_t*, const wchar_t*, bool, bool) {};
+    CmakeParser parser(false, quiet);
+    ModelCache cache(root.wstring());
+    std::filesystem::remove(cache.Path(), ec);
+    bool parsed = parser.Parse(root.wstring());
+    std::filesystem::remove(cache.Path(), ec);
+
+    std::string got;
+    if (!parsed || !FindSet(parser.GetModel(), name, got)) {
+        std::printf("FAIL  %s: %s\n", what, parsed ? "no set() in the model" : "parse failed");
+        return false;
+    }
+    if (got == expected) {
+        std::printf("ok    %s\n", what);
+        return true;
+    }
+    std::printf("FAIL  %s: ${%s} is \"%s\", expected \"%s\"\n", what, name, got.c_str(), expected.c_str());
+    return false;
+}
+
+int main()
+{
+    ThreadPoolService::Instance();
+    auto work = std::filesystem::temp_directory_path() / "cmakeparser_resolver_check";
+
+    bool ok = true;
+    ok = Check(work, "value is expanded at set() time",
+        { { "CMakeLists.txt", "set(D a)\nset(S ${D}/x.c)\nset(D b)\n" } }, "S", "a/x.c") && ok;
+    ok = Check(work, "mutual references are empty, not a cycle",
+        { { "CMakeLists.txt", "set(A ${B})\nset(B ${A})\n" } }, "B", "") && ok;
+    ok = Check(work, "bracket argument stays literal",
+        { { "CMakeLists.txt", "set(Y y)\nset(X [=[${Y}]=])\nset(Z ${X})\n" } }, "Z", "${Y}") && ok;
+    ok = Check(work, "self-referencing append",
+        { { "CMakeLists.txt", "set(SRC a.c)\nset(SRC ${SRC} b.c)\nset(SRC ${SRC} c.c)\n" } }, "SRC", "a.c;b.c;c.c") && ok;
+    ok = Check(work, "nested reference",
+        { { "CMakeLists.txt", "set(P HAL)\nset(HAL_DIR hal)\nset(R ${${P}_DIR}/inc)\n" } }, "R", "hal/inc") && ok;
+    ok = Check(work, "include() path is expanded at set() time",
+        { { "CMakeLists.txt", "set(D one)\nset(P ${D}/x.cmake)\nset(D two)\ninclude(${P})\n" },
+          { "one/x.cmake", "set(FROM one)\n" },
+          { "two/x.cmake", "set(FROM two)\n" } }, "FROM", "one") && ok;
+    ok = Check(work, "add_subdirectory() scope is undone",
+        { { "CMakeLists.txt", "set(V root)\nadd_subdirectory(sub)\nset(AFTER ${V})\n" },
+          { "sub/CMakeLists.txt", "set(V sub)\nset(IN ${V})\n" } }, "AFTER", "root") && ok;
+
+    std::error_code ec;
+    std::filesystem::remove_all(work, ec);
+    return ok ? 0 : 1;
+}
\ No newline at end of file